@@ -1,9 +1,34 @@
 #include "devices/block.h"
 #include <list.h>
+#include <round.h>
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Ticks a queued request of each class may wait before it is
+   served ahead of everything else, so that no class starves. */
+static const int64_t deadlines[BLOCK_IO_CLASS_CNT] =
+  {
+    TIMER_FREQ / 20,            /* BLOCK_IO_DEMAND. */
+    TIMER_FREQ / 10,            /* BLOCK_IO_SWAP. */
+    TIMER_FREQ,                 /* BLOCK_IO_READ_AHEAD. */
+    TIMER_FREQ * 5,             /* BLOCK_IO_WRITE_BACK. */
+  };
+
+/* Most sectors the dispatcher merges into one driver call, and
+   the pages of its bounce buffer for doing so. */
+#define MERGE_PAGES 8
+#define MERGE_MAX (MERGE_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Most devices one block device may be stacked on. */
+#define BLOCK_LOWER_MAX 4
 
 /* A block device. */
 struct block
@@ -16,11 +41,34 @@ struct block
 
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
+    struct block *lower[BLOCK_LOWER_MAX]; /* Devices it is stacked on. */
+    size_t lower_cnt;                   /* Number of them. */
+
+    /* Request queue. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct list queue;                  /* block_requests, oldest first. */
+    struct condition queue_nonempty;    /* Signaled on submission. */
+    bool dispatching;                   /* Dispatcher thread started? */
+    block_sector_t head;                /* Sector after the last served. */
+    uint8_t *merge_buf;                 /* Bounce buffer, or null. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    /* Statistics. */
+    struct block_stats stats;           /* Counters and histograms. */
+    block_sector_t next_sector;         /* Sector after last submitted. */
+    unsigned depth;                     /* Requests queued or in progress. */
+    uint64_t depth_start;               /* timer_cycles() at first request. */
+    uint64_t depth_changed;             /* timer_cycles() at last change. */
+    uint64_t depth_area;                /* Sum of depth times cycles. */
   };
 
+/* Ring of the last BLOCK_TRACE_MAX requests submitted while
+   tracing, allocated by the first block_trace_start(), or null.
+   Tracing state is protected by disabling interrupts. */
+static struct block_trace_entry *trace;
+static bool tracing;                    /* Tracing on? */
+static size_t trace_cnt;                /* Requests traced in all. */
+static uint64_t trace_start;            /* timer_cycles() at start. */
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 
@@ -28,6 +76,9 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void dispatcher (void *block_);
+static void transfer (struct block *, block_sector_t, block_sector_t cnt,
+                      void *, bool write);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -81,6 +132,31 @@ block_next (struct block *block)
   return list_elem_to_block (list_next (&block->list_elem));
 }
 
+/* Records that BLOCK is stacked on LOWER, that is, that its
+   driver turns requests to BLOCK into requests to LOWER, as a
+   partition does for its disk and a stripe for its members. */
+void
+block_add_lower (struct block *block, struct block *lower)
+{
+  ASSERT (block->lower_cnt < BLOCK_LOWER_MAX);
+  block->lower[block->lower_cnt++] = lower;
+}
+
+/* Returns true if BLOCK is LOWER or is stacked on it, directly
+   or through other devices. */
+bool
+block_stacked_on (struct block *block, struct block *lower)
+{
+  size_t i;
+
+  if (block == lower)
+    return true;
+  for (i = 0; i < block->lower_cnt; i++)
+    if (block_stacked_on (block->lower[i], lower))
+      return true;
+  return false;
+}
+
 /* Returns the block device with the given NAME, or a null
    pointer if no block device has that name. */
 struct block *
@@ -121,8 +197,7 @@ void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer (block, sector, 1, buffer, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -135,8 +210,482 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  transfer (block, sector, 1, (void *) buffer, true);
+}
+
+/* Verifies that the CNT sectors starting at SECTOR are within
+   BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector,
+               block_sector_t cnt)
+{
+  ASSERT (cnt > 0);
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", cnt=%"PRDSNu", "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt, block->size);
+}
+
+/* Reads the CNT consecutive sectors starting at SECTOR from
+   BLOCK into BUFFER, which must have room for CNT *
+   BLOCK_SECTOR_SIZE bytes, with as few device commands as the
+   driver allows.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     block_sector_t cnt, void *buffer_)
+{
+  check_sectors (block, sector, cnt);
+  transfer (block, sector, cnt, buffer_, false);
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes,
+   with as few device commands as the driver allows.  Returns
+   after the block device has acknowledged receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      block_sector_t cnt, const void *buffer_)
+{
+  check_sectors (block, sector, cnt);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  transfer (block, sector, cnt, (void *) buffer_, true);
+}
+
+/* Logs request R, just submitted to BLOCK, in the trace ring. */
+static void
+trace_request (struct block *block, const struct block_request *r)
+{
+  struct block_trace_entry *e;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (tracing)
+    {
+      e = &trace[trace_cnt++ % BLOCK_TRACE_MAX];
+      e->time_us = timer_cycles_to_us (r->submitted - trace_start);
+      e->sector = r->sector;
+      e->cnt = r->cnt;
+      e->tid = thread_current ()->tid;
+      e->write = r->write;
+      e->io_class = r->io_class;
+      strlcpy (e->device, block->name, sizeof e->device);
+    }
+  intr_set_level (old_level);
+}
+
+/* Starts logging requests to all block devices, discarding any
+   logged earlier.  Returns false if memory for the trace ring is
+   short. */
+bool
+block_trace_start (void)
+{
+  enum intr_level old_level;
+
+  if (trace == NULL)
+    {
+      trace = palloc_get_multiple (0, BLOCK_TRACE_PAGES);
+      if (trace == NULL)
+        return false;
+    }
+  old_level = intr_disable ();
+  trace_cnt = 0;
+  trace_start = timer_cycles ();
+  tracing = true;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Stops logging requests.  The log stays for block_trace_read(). */
+void
+block_trace_stop (void)
+{
+  tracing = false;
+}
+
+/* Copies up to MAX of the most recent logged requests into
+   ENTRIES, oldest first, and returns the number copied. */
+size_t
+block_trace_read (struct block_trace_entry *entries, size_t max)
+{
+  enum intr_level old_level;
+  size_t cnt, i;
+
+  old_level = intr_disable ();
+  cnt = trace_cnt < BLOCK_TRACE_MAX ? trace_cnt : BLOCK_TRACE_MAX;
+  if (cnt > max)
+    cnt = max;
+  for (i = 0; i < cnt; i++)
+    entries[i] = trace[(trace_cnt - cnt + i) % BLOCK_TRACE_MAX];
+  intr_set_level (old_level);
+  return cnt;
+}
+
+/* Adds DELTA to BLOCK's queue depth at time NOW, a value
+   returned by timer_cycles(), first accounting for the time
+   spent at the old depth.  BLOCK's queue_lock must be held. */
+static void
+change_depth (struct block *block, uint64_t now, int delta)
+{
+  if (block->depth_start == 0)
+    block->depth_start = now;
+  else if (now > block->depth_changed)
+    block->depth_area += block->depth * (now - block->depth_changed);
+  block->depth_changed = now;
+  block->depth += delta;
+  if (block->depth > block->stats.max_depth)
+    block->stats.max_depth = block->depth;
+}
+
+/* Counts request R, which finished at time NOW, in BLOCK's
+   latency histograms.  BLOCK's queue_lock must be held. */
+static void
+record_latency (struct block *block, const struct block_request *r,
+                uint64_t now)
+{
+  uint64_t us = timer_cycles_to_us (now - r->submitted);
+  int bucket = 0;
+
+  while (us > 0 && bucket < BLOCK_LATENCY_BUCKETS - 1)
+    {
+      us >>= 1;
+      bucket++;
+    }
+  if (r->write)
+    block->stats.write_latency[bucket]++;
+  else
+    block->stats.read_latency[bucket]++;
+}
+
+/* Queues request R on BLOCK and returns at once.  R->done is
+   called, from BLOCK's dispatcher thread, when the transfer has
+   finished.  R must stay allocated until then. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  block_submit_batch (block, r, 1);
+}
+
+/* Queues the CNT requests in array R on BLOCK together, as with
+   block_submit(), so that the dispatcher sees them all at once
+   and can merge those that continue each other. */
+void
+block_submit_batch (struct block *block, struct block_request *r,
+                    size_t cnt)
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      check_sectors (block, r[i].sector, r[i].cnt);
+      ASSERT (!r[i].write || block->type != BLOCK_FOREIGN);
+      r[i].io_class = t->io_class;
+      r[i].priority = (t->io_priority >= 0 ? t->io_priority
+                       : thread_get_priority ());
+      r[i].deadline = timer_ticks () + deadlines[r[i].io_class];
+      r[i].submitted = timer_cycles ();
+      if (tracing && !t->block_dispatcher)
+        trace_request (block, &r[i]);
+    }
+
+  lock_acquire (&block->queue_lock);
+  if (!block->dispatching)
+    {
+      char name[sizeof block->name + 3];
+
+      snprintf (name, sizeof name, "%s-io", block->name);
+      if (thread_create (name, PRI_MAX, dispatcher, block) == TID_ERROR)
+        PANIC ("%s: cannot start dispatcher thread", block->name);
+      block->dispatching = true;
+    }
+  for (i = 0; i < cnt; i++)
+    {
+      list_push_back (&block->queue, &r[i].elem);
+      if (r[i].write)
+        block->stats.write_cnt += r[i].cnt;
+      else
+        block->stats.read_cnt += r[i].cnt;
+      block->stats.class_cnt[r[i].io_class]++;
+      if (r[i].sector == block->next_sector)
+        block->stats.sequential_cnt++;
+      else
+        block->stats.random_cnt++;
+      block->next_sector = r[i].sector + r[i].cnt;
+      change_depth (block, r[i].submitted, 1);
+    }
+  cond_signal (&block->queue_nonempty, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Returns a human-readable name for I/O class CLASS. */
+const char *
+block_io_class_name (enum block_io_class class)
+{
+  static const char *class_names[BLOCK_IO_CLASS_CNT] =
+    {
+      "demand",
+      "swap",
+      "read_ahead",
+      "write_back",
+    };
+
+  ASSERT (class < BLOCK_IO_CLASS_CNT);
+  return class_names[class];
+}
+
+/* Sets the class of the block I/O the running thread submits to
+   CLASS and returns the previous class. */
+enum block_io_class
+block_set_io_class (enum block_io_class class)
+{
+  struct thread *t = thread_current ();
+  enum block_io_class old = t->io_class;
+
+  ASSERT (class < BLOCK_IO_CLASS_CNT);
+  t->io_class = class;
+  return old;
+}
+
+/* Wakes up the thread waiting in transfer() for R. */
+static void
+transfer_done (struct block_request *r)
+{
+  sema_up (r->aux);
+}
+
+/* Reads or writes, according to WRITE, the CNT sectors starting
+   at SECTOR between BLOCK and BUFFER through BLOCK's queue, and
+   waits for the transfer to finish. */
+static void
+transfer (struct block *block, block_sector_t sector, block_sector_t cnt,
+          void *buffer, bool write)
+{
+  struct block_request r;
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffer = buffer;
+  r.write = write;
+  r.done = transfer_done;
+  r.aux = &done;
+  block_submit (block, &r);
+  sema_down (&done);
+}
+
+/* Returns true if requests A and B touch a common sector. */
+static bool
+overlaps (const struct block_request *a, const struct block_request *b)
+{
+  return a->sector < b->sector + b->cnt && b->sector < a->sector + a->cnt;
+}
+
+/* Returns the oldest request in BLOCK's queue that R overlaps and
+   that was submitted before R, or a null pointer if none. */
+static struct block_request *
+earlier_overlap (struct block *block, struct block_request *r)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&block->queue); e != &r->elem; e = list_next (e))
+    {
+      struct block_request *q = list_entry (e, struct block_request, elem);
+      if (overlaps (q, r))
+        return q;
+    }
+  return NULL;
+}
+
+/* Chooses the next request to serve from BLOCK's nonempty queue:
+   the one with the earliest deadline if that has passed, and
+   otherwise, among the requests of the most urgent class and
+   then the highest priority, the first at or after the head in
+   ascending sector order, wrapping around to the lowest
+   (C-SCAN).  A request that overlaps one submitted earlier
+   yields to it. */
+static struct block_request *
+choose_request (struct block *block)
+{
+  struct block_request *urgent = NULL, *ahead = NULL, *lowest = NULL;
+  struct block_request *best = NULL;
+  struct block_request *r, *q;
+  struct list_elem *e;
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      r = list_entry (e, struct block_request, elem);
+      if (urgent == NULL || r->deadline < urgent->deadline)
+        urgent = r;
+      if (best == NULL || r->io_class < best->io_class
+          || (r->io_class == best->io_class && r->priority > best->priority))
+        best = r;
+    }
+  if (urgent->deadline <= timer_ticks ())
+    r = urgent;
+  else
+    {
+      for (e = list_begin (&block->queue); e != list_end (&block->queue);
+           e = list_next (e))
+        {
+          r = list_entry (e, struct block_request, elem);
+          if (r->io_class != best->io_class || r->priority != best->priority)
+            continue;
+          if (r->sector >= block->head
+              && (ahead == NULL || r->sector < ahead->sector))
+            ahead = r;
+          if (lowest == NULL || r->sector < lowest->sector)
+            lowest = r;
+        }
+      r = ahead != NULL ? ahead : lowest;
+    }
+  while ((q = earlier_overlap (block, r)) != NULL)
+    r = q;
+  return r;
+}
+
+/* Removes the next request from BLOCK's nonempty queue into
+   BATCH, followed by any requests in the same direction that
+   continue it on disk, up to MERGE_MAX sectors in all.  Returns
+   the number of sectors in BATCH. */
+static block_sector_t
+take_batch (struct block *block, struct list *batch)
+{
+  struct block_request *first = choose_request (block);
+  block_sector_t cnt = first->cnt;
+  bool merged = true;
+
+  list_remove (&first->elem);
+  list_push_back (batch, &first->elem);
+  while (merged && block->merge_buf != NULL)
+    {
+      struct list_elem *e;
+
+      merged = false;
+      for (e = list_begin (&block->queue); e != list_end (&block->queue);
+           e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request,
+                                                elem);
+          if (r->write == first->write
+              && r->sector == first->sector + cnt
+              && cnt + r->cnt <= MERGE_MAX
+              && earlier_overlap (block, r) == NULL)
+            {
+              list_remove (&r->elem);
+              list_push_back (batch, &r->elem);
+              cnt += r->cnt;
+              merged = true;
+              break;
+            }
+        }
+    }
+  block->head = first->sector + cnt;
+  return cnt;
+}
+
+/* Has BLOCK's driver move the CNT sectors starting at SECTOR to
+   or from BUFFER, according to WRITE. */
+static void
+drive (struct block *block, block_sector_t sector, block_sector_t cnt,
+       uint8_t *buffer, bool write)
+{
+  block_sector_t i;
+
+  if (write && block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else if (!write && block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      if (write)
+        block->ops->write (block->aux, sector + i,
+                           buffer + i * BLOCK_SECTOR_SIZE);
+      else
+        block->ops->read (block->aux, sector + i,
+                          buffer + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Serves BLOCK's queue, one batch of merged requests at a time,
+   and runs each request's completion callback. */
+static void
+dispatcher (void *block_)
+{
+  struct block *block = block_;
+
+  thread_current ()->block_dispatcher = true;
+  block->merge_buf = palloc_get_multiple (0, MERGE_PAGES);
+  for (;;)
+    {
+      struct block_request *first;
+      struct list batch;
+      block_sector_t cnt;
+      uint64_t now;
+      uint8_t *p;
+      struct list_elem *e;
+
+      list_init (&batch);
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->queue))
+        cond_wait (&block->queue_nonempty, &block->queue_lock);
+      cnt = take_batch (block, &batch);
+      lock_release (&block->queue_lock);
+
+      /* Requests a stacked driver makes on other devices inherit
+         the class and priority of the batch, not those of this
+         PRI_MAX thread. */
+      first = list_entry (list_front (&batch), struct block_request, elem);
+      block_set_io_class (first->io_class);
+      thread_current ()->io_priority = first->priority;
+      if (list_size (&batch) == 1)
+        drive (block, first->sector, cnt, first->buffer, first->write);
+      else
+        {
+          if (first->write)
+            for (p = block->merge_buf, e = list_begin (&batch);
+                 e != list_end (&batch); e = list_next (e))
+              {
+                struct block_request *r = list_entry (e, struct block_request,
+                                                      elem);
+                memcpy (p, r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+                p += r->cnt * BLOCK_SECTOR_SIZE;
+              }
+          drive (block, first->sector, cnt, block->merge_buf, first->write);
+          if (!first->write)
+            for (p = block->merge_buf, e = list_begin (&batch);
+                 e != list_end (&batch); e = list_next (e))
+              {
+                struct block_request *r = list_entry (e, struct block_request,
+                                                      elem);
+                memcpy (r->buffer, p, r->cnt * BLOCK_SECTOR_SIZE);
+                p += r->cnt * BLOCK_SECTOR_SIZE;
+              }
+        }
+
+      now = timer_cycles ();
+      lock_acquire (&block->queue_lock);
+      for (e = list_begin (&batch); e != list_end (&batch);
+           e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request,
+                                                elem);
+          record_latency (block, r, now);
+          change_depth (block, now, -1);
+        }
+      lock_release (&block->queue_lock);
+
+      while (!list_empty (&batch))
+        {
+          struct block_request *r = list_entry (list_pop_front (&batch),
+                                                struct block_request, elem);
+          r->done (r);
+        }
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,24 +709,81 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Copies BLOCK's statistics into STATS, without locking. */
+static void
+get_stats (struct block *block, struct block_stats *stats)
+{
+  uint64_t now = timer_cycles ();
+  uint64_t area = block->depth_area;
+
+  *stats = block->stats;
+  stats->avg_depth_x100 = 0;
+  if (block->depth_start != 0 && now > block->depth_start)
+    {
+      if (now > block->depth_changed)
+        area += block->depth * (now - block->depth_changed);
+      stats->avg_depth_x100 = area * 100 / (now - block->depth_start);
+    }
+}
+
+/* Prints the nonempty buckets of latency HISTOGRAM, labeled
+   NAME. */
+static void
+print_latency (const char *name, const unsigned long long *histogram)
+{
+  int i;
+
+  printf ("  %s latency:", name);
+  for (i = 0; i < BLOCK_LATENCY_BUCKETS; i++)
+    if (histogram[i] != 0)
+      printf (" %s%lluus %llu", i < BLOCK_LATENCY_BUCKETS - 1 ? "<" : ">=",
+              1ULL << (i < BLOCK_LATENCY_BUCKETS - 1 ? i : i - 1),
+              histogram[i]);
+  printf ("\n");
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
 {
-  int i;
+  int i, c;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
       struct block *block = block_by_role[i];
-      if (block != NULL)
-        {
-          printf ("%s (%s): %llu reads, %llu writes\n",
-                  block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
-        }
+      struct block_stats stats;
+
+      if (block == NULL)
+        continue;
+      get_stats (block, &stats);
+      printf ("%s (%s): %llu reads, %llu writes\n",
+              block->name, block_type_name (block->type),
+              stats.read_cnt, stats.write_cnt);
+      if (stats.sequential_cnt + stats.random_cnt == 0)
+        continue;
+      printf ("  requests: %llu sequential, %llu random; "
+              "depth %u.%02u average, %u max\n",
+              stats.sequential_cnt, stats.random_cnt,
+              stats.avg_depth_x100 / 100, stats.avg_depth_x100 % 100,
+              stats.max_depth);
+      printf ("  classes:");
+      for (c = 0; c < BLOCK_IO_CLASS_CNT; c++)
+        printf (" %s %llu", block_io_class_name (c), stats.class_cnt[c]);
+      printf ("\n");
+      print_latency ("read", stats.read_latency);
+      print_latency ("write", stats.write_latency);
     }
 }
 
+/* Stores BLOCK's statistics into STATS. */
+void
+block_get_stats (struct block *block, struct block_stats *stats)
+{
+  lock_acquire (&block->queue_lock);
+  get_stats (block, stats);
+  lock_release (&block->queue_lock);
+}
+
 /* Registers a new block device with the given NAME.  If
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
@@ -198,8 +804,19 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  block->lower_cnt = 0;
+  lock_init (&block->queue_lock);
+  list_init (&block->queue);
+  cond_init (&block->queue_nonempty);
+  block->dispatching = false;
+  block->head = 0;
+  block->merge_buf = NULL;
+  memset (&block->stats, 0, sizeof block->stats);
+  block->next_sector = 0;
+  block->depth = 0;
+  block->depth_start = 0;
+  block->depth_changed = 0;
+  block->depth_area = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -1,8 +1,12 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include <round.h>
+#include "threads/vaddr.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -49,15 +53,122 @@ struct block *block_get_by_name (const char *name);
 struct block *block_first (void);
 struct block *block_next (struct block *);
 
+void block_add_lower (struct block *, struct block *lower);
+bool block_stacked_on (struct block *, struct block *lower);
+
 /* Block device operations. */
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* I/O classes, most urgent first.  A request takes the class
+   and priority of the thread that submits it; see
+   block_set_io_class().  One that a stacked device's driver
+   makes on a device under it takes those of the request it
+   serves. */
+enum block_io_class
+  {
+    BLOCK_IO_DEMAND,             /* Someone is waiting: reads, syncs. */
+    BLOCK_IO_SWAP,               /* Paging to and from swap. */
+    BLOCK_IO_READ_AHEAD,         /* Speculative reads. */
+    BLOCK_IO_WRITE_BACK,         /* Periodic write-behind. */
+    BLOCK_IO_CLASS_CNT
+  };
+
+enum block_io_class block_set_io_class (enum block_io_class);
+
+/* Asynchronous requests.
+   A request is queued on its device and served by the device's
+   dispatcher thread: first any request past its deadline, which
+   depends on its class, then the most urgent class present, then
+   the highest thread priority within it, in C-SCAN order.
+   Adjacent requests in the same direction are merged into one
+   driver call.  Requests that overlap are served in the order
+   they were submitted. */
+struct block_request
+  {
+    struct list_elem elem;              /* Element in device queue. */
+    block_sector_t sector;              /* First sector. */
+    block_sector_t cnt;                 /* Number of sectors. */
+    void *buffer;                       /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                         /* Write (true) or read (false)? */
+
+    /* Set by block_submit(). */
+    enum block_io_class io_class;       /* Submitting thread's class. */
+    int priority;                       /* Submitting thread's priority. */
+    int64_t deadline;                   /* Serve by this tick. */
+    uint64_t submitted;                 /* timer_cycles() at submission. */
+
+    /* Called from the dispatcher thread once the transfer is done.
+       Must not sleep or do block I/O itself. */
+    void (*done) (struct block_request *);
+    void *aux;                          /* For use by DONE. */
+  };
+
+void block_submit (struct block *, struct block_request *);
+void block_submit_batch (struct block *, struct block_request *, size_t cnt);
+
 /* Statistics. */
+
+/* Buckets of a latency histogram.  Bucket 0 counts requests
+   finished less than 1 us after submission, bucket I > 0 those
+   that took [2**(I-1), 2**I) us, and the last bucket also all
+   that took longer. */
+#define BLOCK_LATENCY_BUCKETS 24
+
+struct block_stats
+  {
+    unsigned long long read_cnt;        /* Sectors read. */
+    unsigned long long write_cnt;       /* Sectors written. */
+    unsigned long long class_cnt[BLOCK_IO_CLASS_CNT]; /* Requests by class. */
+    unsigned long long sequential_cnt;  /* Requests that start where the
+                                           previous one ended. */
+    unsigned long long random_cnt;      /* Other requests. */
+    unsigned long long read_latency[BLOCK_LATENCY_BUCKETS];
+    unsigned long long write_latency[BLOCK_LATENCY_BUCKETS];
+    unsigned max_depth;                 /* Most requests queued or in
+                                           progress at once. */
+    unsigned avg_depth_x100;            /* Their average over time, in
+                                           hundredths. */
+  };
+
 void block_print_stats (void);
+void block_get_stats (struct block *, struct block_stats *);
+const char *block_io_class_name (enum block_io_class);
+
+/* Tracing.
+   While tracing is on, every request submitted to any block
+   device is logged in a ring of the last BLOCK_TRACE_MAX, except
+   those a stacked device's driver makes on the devices under
+   it, so that each transfer is logged once. */
+#define BLOCK_TRACE_MAX 2048
+
+struct block_trace_entry
+  {
+    uint64_t time_us;                   /* Microseconds since tracing
+                                           started. */
+    block_sector_t sector;              /* First sector. */
+    uint32_t cnt;                       /* Number of sectors. */
+    int32_t tid;                        /* Submitting thread. */
+    uint8_t write;                      /* Write (1) or read (0)? */
+    uint8_t io_class;                   /* Submitting thread's class. */
+    char device[10];                    /* Device name, maybe truncated. */
+  };
+
+/* Pages needed to hold a full trace ring. */
+#define BLOCK_TRACE_PAGES DIV_ROUND_UP (BLOCK_TRACE_MAX \
+                                        * sizeof (struct block_trace_entry), \
+                                        PGSIZE)
+
+bool block_trace_start (void);
+void block_trace_stop (void);
+size_t block_trace_read (struct block_trace_entry *, size_t max);
 
 /* Lower-level interface to block device drivers. */
 
@@ -65,6 +176,14 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Transfer CNT consecutive sectors at once.  Optional: if
+       null, the block layer calls read or write once per
+       sector instead. */
+    void (*read_multiple) (void *aux, block_sector_t, block_sector_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, block_sector_t cnt,
+                            const void *buffer);
   };
 
 struct block *block_register (const char *name, enum block_type,
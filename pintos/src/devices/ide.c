@@ -3,12 +3,15 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -30,10 +33,24 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, found through PCI. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt (write 1 to clear). */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +66,15 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Most sectors one command can transfer.  A sector count of 256
+   is written to the Sector Count register as 0. */
+#define MAX_CMD_SECTORS 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,7 +83,25 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple;               /* Sectors per interrupt with READ/WRITE
+                                   MULTIPLE, or 1 if not supported. */
+    bool dma;                   /* Use DMA? */
+  };
+
+/* A Physical Region Descriptor: one physically contiguous piece
+   of a DMA buffer, not crossing a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes; 0 means 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last descriptor. */
   };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Descriptors per channel.  A command moves at most
+   MAX_CMD_SECTORS * BLOCK_SECTOR_SIZE = 128 kB of physically
+   contiguous kernel memory, which spans at most 3 of them. */
+#define PRD_CNT 8
 
 /* An ATA channel (aka controller).
    Each channel can control up to two disks. */
@@ -72,6 +116,9 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* Bus master base I/O port, or 0. */
+    struct prd *prdt;           /* PRD table for DMA transfers. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -79,16 +126,33 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* PRD tables.  Each is 8-byte aligned and may not cross a 64 kB
+   boundary, which aligning each to its own size guarantees. */
+static struct prd prd_tables[CHANNEL_CNT][PRD_CNT]
+  __attribute__ ((aligned (PRD_CNT * sizeof (struct prd))));
+
 static struct block_operations ide_operations;
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void set_multiple_mode (struct ata_disk *);
+static uint16_t find_bus_master (void);
+
+static void pio_read (struct ata_disk *, block_sector_t, block_sector_t cnt,
+                      void *);
+static void pio_write (struct ata_disk *, block_sector_t, block_sector_t cnt,
+                       const void *);
+static bool dma_transfer (struct ata_disk *, block_sector_t,
+                          block_sector_t cnt, const void *, bool write);
+
+static void select_sectors (struct ata_disk *, block_sector_t,
+                            block_sector_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, block_sector_t cnt);
+static void output_sectors (struct channel *, const void *,
+                            block_sector_t cnt);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -101,6 +165,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -126,6 +191,8 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+      c->prdt = prd_tables[chan_no];
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +203,8 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->multiple = 1;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -279,7 +348,7 @@ identify_ata_device (struct ata_disk *d)
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sectors (c, id, 1);
 
   /* Calculate capacity.
      Read model name and serial number. */
@@ -303,12 +372,75 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  /* Move several sectors per interrupt, if the disk can, and use
+     DMA if both it and the controller can.  (Bit 8 of word 49
+     says the disk supports DMA.) */
+  d->multiple = (uint8_t) id[47 * 2];
+  set_multiple_mode (d);
+  d->dma = c->bm_base != 0 && (id[49 * 2 + 1] & 0x01) != 0;
+  if (d->dma)
+    snprintf (extra_info + strlen (extra_info),
+              sizeof extra_info - strlen (extra_info), ", DMA");
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
 
+/* Sends a SET MULTIPLE MODE command to disk D for the largest
+   power of 2 no greater than D->multiple, which on entry is the
+   most sectors per interrupt the disk reported it supports.
+   Leaves D->multiple set to the block size in use, or to 1 if
+   the disk cannot transfer more than one sector per interrupt. */
+static void
+set_multiple_mode (struct ata_disk *d)
+{
+  struct channel *c = d->channel;
+  int sectors = 1;
+
+  while (sectors * 2 <= d->multiple)
+    sectors *= 2;
+  d->multiple = 1;
+  if (sectors == 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), sectors);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+    d->multiple = sectors;
+}
+
+/* Looks for a PCI IDE controller that can act as a bus master
+   and enables bus mastering on it.  Returns its bus master base
+   I/O port, whose first 8 ports serve the primary channel and
+   next 8 the secondary channel, or 0 if there is none. */
+static uint16_t
+find_bus_master (void)
+{
+  struct pci_address addr;
+  uint32_t bar4;
+
+  /* Class 1 is mass storage, subclass 1 IDE.  Bit 7 of the
+     programming interface says the controller can bus master. */
+  if (!pci_find_class (0x01, 0x01, &addr)
+      || !(pci_read_config (addr, PCI_REG_CLASS) & 0x8000))
+    return 0;
+
+  /* BAR4 is the bus master block, in I/O space. */
+  bar4 = pci_read_config (addr, PCI_REG_BAR0 + 4 * 4);
+  if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+    return 0;
+
+  pci_write_config (addr, PCI_REG_COMMAND,
+                    (pci_read_config (addr, PCI_REG_COMMAND)
+                     | PCI_CMD_IO | PCI_CMD_MASTER));
+  return bar4 & 0xfffc;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,63 +469,231 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Issues one command per MAX_CMD_SECTORS sectors, by DMA if
+   possible and by PIO otherwise.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read_multiple (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                   void *buffer_)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (cnt > 0)
+    {
+      block_sector_t cmd_cnt = cnt < MAX_CMD_SECTORS ? cnt : MAX_CMD_SECTORS;
+
+      if (!dma_transfer (d, sec_no, cmd_cnt, buffer, false))
+        pio_read (d, sec_no, cmd_cnt, buffer);
+      buffer += cmd_cnt * BLOCK_SECTOR_SIZE;
+      sec_no += cmd_cnt;
+      cnt -= cmd_cnt;
+    }
   lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Writes the CNT sectors starting at SEC_NO to disk D from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data.
+   Issues one command per MAX_CMD_SECTORS sectors, by DMA if
+   possible and by PIO otherwise.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write_multiple (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                    const void *buffer_)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  while (cnt > 0)
+    {
+      block_sector_t cmd_cnt = cnt < MAX_CMD_SECTORS ? cnt : MAX_CMD_SECTORS;
+
+      if (!dma_transfer (d, sec_no, cmd_cnt, buffer, true))
+        pio_write (d, sec_no, cmd_cnt, buffer);
+      buffer += cmd_cnt * BLOCK_SECTOR_SIZE;
+      sec_no += cmd_cnt;
+      cnt -= cmd_cnt;
+    }
   lock_release (&c->lock);
 }
 
+/* Reads the CNT sectors, at most MAX_CMD_SECTORS, starting at
+   SEC_NO from disk D into BUFFER by PIO, taking one interrupt
+   per D->multiple sectors.  D's channel must be locked. */
+static void
+pio_read (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+          void *buffer_)
+{
+  struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
+
+  select_sectors (d, sec_no, cnt);
+  issue_pio_command (c, (d->multiple > 1 ? CMD_READ_MULTIPLE
+                         : CMD_READ_SECTOR_RETRY));
+  while (cnt > 0)
+    {
+      block_sector_t n = cnt < (block_sector_t) d->multiple
+                         ? cnt : (block_sector_t) d->multiple;
+
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
+      input_sectors (c, buffer, n);
+      buffer += n * BLOCK_SECTOR_SIZE;
+      sec_no += n;
+      cnt -= n;
+    }
+}
+
+/* Writes the CNT sectors, at most MAX_CMD_SECTORS, starting at
+   SEC_NO to disk D from BUFFER by PIO, taking one interrupt per
+   D->multiple sectors.  D's channel must be locked. */
+static void
+pio_write (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+           const void *buffer_)
+{
+  struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
+
+  select_sectors (d, sec_no, cnt);
+  issue_pio_command (c, (d->multiple > 1 ? CMD_WRITE_MULTIPLE
+                         : CMD_WRITE_SECTOR_RETRY));
+  while (cnt > 0)
+    {
+      block_sector_t n = cnt < (block_sector_t) d->multiple
+                         ? cnt : (block_sector_t) d->multiple;
+
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
+      output_sectors (c, buffer, n);
+      sema_down (&c->completion_wait);
+      buffer += n * BLOCK_SECTOR_SIZE;
+      sec_no += n;
+      cnt -= n;
+    }
+}
+
+/* Fills in channel C's PRD table to describe the SIZE bytes at
+   BUFFER.  Returns false if BUFFER cannot be used for DMA: if it
+   is not in kernel memory, whose physical addresses are
+   contiguous, or is not 2-byte aligned. */
+static bool
+build_prd_table (struct channel *c, const void *buffer, size_t size)
+{
+  uintptr_t phys;
+  int i;
+
+  if (!is_kernel_vaddr (buffer) || ((uintptr_t) buffer & 1) != 0)
+    return false;
+  phys = vtop (buffer);
+  for (i = 0; size > 0; i++)
+    {
+      size_t chunk = 0x10000 - (phys & 0xffff);
+      if (chunk > size)
+        chunk = size;
+
+      ASSERT (i < PRD_CNT);
+      c->prdt[i].addr = phys;
+      c->prdt[i].size = chunk & 0xffff;
+      c->prdt[i].flags = size == chunk ? PRD_EOT : 0;
+      phys += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
+/* Moves the CNT sectors, at most MAX_CMD_SECTORS, starting at
+   SEC_NO between disk D and BUFFER by bus-master DMA: from
+   BUFFER to the disk if WRITE, the other way otherwise.  The
+   calling thread sleeps until the completion interrupt, leaving
+   the CPU free for the whole transfer.
+   Returns false if D or BUFFER cannot use DMA or the transfer
+   failed, in which case the caller should use PIO instead.  After
+   a failure, D uses PIO from then on.  D's channel must be
+   locked. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+              const void *buffer, bool write)
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BM_CMD_READ;
+  uint8_t bm_status, status;
+
+  if (!d->dma || !build_prd_table (c, buffer, cnt * BLOCK_SECTOR_SIZE))
+    return false;
+
+  /* Set up the controller, then the disk, then start. */
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c), inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+  select_sectors (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), direction);
+  bm_status = inb (reg_bm_status (c));
+  status = inb (reg_alt_status (c));
+  outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+  if ((bm_status & BM_STA_ERR) != 0 || (status & (STA_ERR | STA_DRQ)) != 0)
+    {
+      printf ("%s: DMA failed, sector=%"PRDSNu", falling back to PIO\n",
+              d->name, sec_no);
+      d->dma = false;
+      return false;
+    }
+  return true;
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d, sec_no, 1, buffer);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection and
+   count registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sectors (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_CMD_SECTORS);
+  ASSERT (sec_no < (1UL << 28) && cnt <= (1UL << 28) - sec_no);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -414,20 +714,22 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sectors (struct channel *c, void *sectors, block_sector_t cnt) 
 {
-  insw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain BLOCK_SECTOR_SIZE bytes. */
+/* Writes CNT sectors from SECTORS to channel C's data register
+   in PIO mode.  SECTORS must contain CNT * BLOCK_SECTOR_SIZE
+   bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sectors (struct channel *c, const void *sectors, block_sector_t cnt) 
 {
-  outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
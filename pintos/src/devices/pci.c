@@ -0,0 +1,80 @@
+#include "devices/pci.h"
+#include "threads/io.h"
+
+/* This code reads and writes PCI configuration space with
+   configuration mechanism #1, which every PC chipset Pintos runs
+   on supports. */
+
+/* I/O ports. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Selects a configuration register. */
+#define PCI_CONFIG_DATA 0xcfc   /* Reads or writes the selected one. */
+
+/* Selects register REG, which must be a multiple of 4, of the
+   function at ADDR. */
+static void
+select_register (struct pci_address addr, int reg)
+{
+  outl (PCI_CONFIG_ADDR, (0x80000000u | (addr.bus << 16) | (addr.dev << 11)
+                          | (addr.func << 8) | (reg & 0xfc)));
+}
+
+/* Returns 32-bit configuration register REG of the function at
+   ADDR. */
+uint32_t
+pci_read_config (struct pci_address addr, int reg)
+{
+  select_register (addr, reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to 32-bit configuration register REG of the
+   function at ADDR. */
+void
+pci_write_config (struct pci_address addr, int reg, uint32_t value)
+{
+  select_register (addr, reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Searches every bus for the first function with the given
+   CLASS and SUBCLASS.  If one is found, stores its address in
+   *ADDR and returns true; otherwise, returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_address *addr)
+{
+  struct pci_address a;
+  int bus, dev, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func = 0; func < 8; func++)
+        {
+          uint32_t class_reg;
+
+          a.bus = bus;
+          a.dev = dev;
+          a.func = func;
+          if ((pci_read_config (a, PCI_REG_ID) & 0xffff) == 0xffff)
+            {
+              /* No such function.  Function 0 missing means no
+                 device at all. */
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          class_reg = pci_read_config (a, PCI_REG_CLASS);
+          if ((class_reg >> 24) == class
+              && ((class_reg >> 16) & 0xff) == subclass)
+            {
+              *addr = a;
+              return true;
+            }
+
+          /* Only multi-function devices have functions 1...7. */
+          if (func == 0
+              && !(pci_read_config (a, PCI_REG_HEADER) & 0x00800000))
+            break;
+        }
+  return false;
+}
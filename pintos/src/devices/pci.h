@@ -0,0 +1,31 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A PCI function's address in configuration space. */
+struct pci_address
+  {
+    uint8_t bus;                /* Bus, 0...255. */
+    uint8_t dev;                /* Device, 0...31. */
+    uint8_t func;               /* Function, 0...7. */
+  };
+
+/* Configuration space registers (offsets in bytes). */
+#define PCI_REG_ID 0x00         /* Vendor ID 15:0, device ID 31:16. */
+#define PCI_REG_COMMAND 0x04    /* Command 15:0, status 31:16. */
+#define PCI_REG_CLASS 0x08      /* Revision 7:0, prog IF 15:8,
+                                   subclass 23:16, class 31:24. */
+#define PCI_REG_HEADER 0x0c     /* Header type 23:16. */
+#define PCI_REG_BAR0 0x10       /* Base address registers 0...5. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* Allow bus mastering. */
+
+uint32_t pci_read_config (struct pci_address, int reg);
+void pci_write_config (struct pci_address, int reg, uint32_t);
+bool pci_find_class (uint8_t class, uint8_t subclass, struct pci_address *);
+
+#endif /* devices/pci.h */
@@ -0,0 +1,120 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk keeps its sectors in kernel pages, allocated when
+   it is created, so that it costs no device time at all.  It is
+   a raw device: give its name to -filesys, -scratch or -swap to
+   use it for that role. */
+struct ramdisk
+  {
+    uint8_t **pages;                    /* Pages holding the sectors. */
+    size_t page_cnt;                    /* Number of pages. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Number of RAM disks created so far, for naming them. */
+static int ramdisk_cnt;
+
+/* Creates a zero-filled RAM disk of KB kilobytes, rounded up to
+   whole pages, named "ramN".  Panics if memory is short. */
+void
+ramdisk_create (size_t kb)
+{
+  struct ramdisk *rd;
+  char name[16];
+  size_t i;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("Failed to allocate memory for RAM disk descriptor");
+  rd->page_cnt = DIV_ROUND_UP (kb * 1024, PGSIZE);
+  rd->pages = malloc (rd->page_cnt * sizeof *rd->pages);
+  if (rd->page_cnt == 0 || rd->pages == NULL)
+    PANIC ("Cannot create a RAM disk of %zu kB", kb);
+  for (i = 0; i < rd->page_cnt; i++)
+    {
+      rd->pages[i] = palloc_get_page (PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("Out of memory for a RAM disk of %zu kB", kb);
+    }
+
+  snprintf (name, sizeof name, "ram%d", ramdisk_cnt++);
+  block_register (name, BLOCK_RAW, "RAM disk",
+                  rd->page_cnt * SECTORS_PER_PAGE, &ramdisk_operations, rd);
+}
+
+/* Copies the CNT sectors starting at SECTOR of RD into BUFFER if
+   WRITE is false, or from BUFFER into them if WRITE is true. */
+static void
+copy (struct ramdisk *rd, block_sector_t sector, block_sector_t cnt,
+      uint8_t *buffer, bool write)
+{
+  while (cnt > 0)
+    {
+      uint8_t *page = rd->pages[sector / SECTORS_PER_PAGE];
+      size_t ofs = sector % SECTORS_PER_PAGE;
+      size_t n = SECTORS_PER_PAGE - ofs < cnt ? SECTORS_PER_PAGE - ofs : cnt;
+
+      if (write)
+        memcpy (page + ofs * BLOCK_SECTOR_SIZE, buffer,
+                n * BLOCK_SECTOR_SIZE);
+      else
+        memcpy (buffer, page + ofs * BLOCK_SECTOR_SIZE,
+                n * BLOCK_SECTOR_SIZE);
+      sector += n;
+      cnt -= n;
+      buffer += n * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Reads sector SECTOR from RAM disk RD into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_read (void *rd, block_sector_t sector, void *buffer)
+{
+  copy (rd, sector, 1, buffer, false);
+}
+
+/* Write sector SECTOR to RAM disk RD from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *rd, block_sector_t sector, const void *buffer)
+{
+  copy (rd, sector, 1, (uint8_t *) buffer, true);
+}
+
+/* Reads CNT sectors starting at SECTOR from RAM disk RD into
+   BUFFER. */
+static void
+ramdisk_read_multiple (void *rd, block_sector_t sector, block_sector_t cnt,
+                       void *buffer)
+{
+  copy (rd, sector, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SECTOR to RAM disk RD from
+   BUFFER. */
+static void
+ramdisk_write_multiple (void *rd, block_sector_t sector, block_sector_t cnt,
+                        const void *buffer)
+{
+  copy (rd, sector, cnt, (uint8_t *) buffer, true);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multiple,
+    ramdisk_write_multiple
+  };
@@ -0,0 +1,187 @@
+#include "devices/stripe.h"
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* A striped (RAID-0) block device spreads its sectors over its
+   members in chunks of STRIPE_CHUNK sectors: chunk 0 on the
+   first member, chunk 1 on the second, and so on round robin.
+   A transfer is queued on every member it touches at once, so
+   members on different IDE channels work in parallel. */
+#define STRIPE_CHUNK 8
+
+/* Most members of a striped device. */
+#define STRIPE_MAX 4
+
+/* Most chunk requests a transfer has in flight at once. */
+#define STRIPE_BATCH 16
+
+/* A striped device. */
+struct stripe
+  {
+    struct block *members[STRIPE_MAX];  /* Underlying block devices. */
+    size_t member_cnt;                  /* Number of members. */
+  };
+
+static struct block_operations stripe_operations;
+
+/* Number of striped devices created so far, for naming them. */
+static int stripe_cnt;
+
+/* Creates and returns a striped block device of the given TYPE
+   over the block devices named in NAMES, separated by commas.
+   Each member contributes as many whole chunks as the smallest
+   member holds.  Panics if a member does not exist or is named
+   twice. */
+struct block *
+stripe_create (enum block_type type, const char *names)
+{
+  char list[128], extra_info[128], name[16];
+  char *member, *save_ptr;
+  block_sector_t member_size = 0;
+  struct block *block;
+  struct stripe *s;
+  size_t i;
+
+  s = calloc (1, sizeof *s);
+  if (s == NULL)
+    PANIC ("Failed to allocate memory for stripe descriptor");
+
+  strlcpy (list, names, sizeof list);
+  for (member = strtok_r (list, ",", &save_ptr); member != NULL;
+       member = strtok_r (NULL, ",", &save_ptr))
+    {
+      block = block_get_by_name (member);
+      if (block == NULL)
+        PANIC ("No such block device \"%s\"", member);
+      if (s->member_cnt >= STRIPE_MAX)
+        PANIC ("Stripe \"%s\" has more than %d members", names, STRIPE_MAX);
+      for (i = 0; i < s->member_cnt; i++)
+        if (s->members[i] == block)
+          PANIC ("Block device \"%s\" named twice in stripe", member);
+      if (s->member_cnt == 0 || block_size (block) < member_size)
+        member_size = block_size (block);
+      s->members[s->member_cnt++] = block;
+    }
+  member_size -= member_size % STRIPE_CHUNK;
+  if (member_size == 0)
+    PANIC ("Stripe \"%s\" has no room for a chunk", names);
+
+  snprintf (name, sizeof name, "stripe%d", stripe_cnt++);
+  snprintf (extra_info, sizeof extra_info, "striped over %s", names);
+  block = block_register (name, type, extra_info, member_size * s->member_cnt,
+                          &stripe_operations, s);
+  for (i = 0; i < s->member_cnt; i++)
+    block_add_lower (block, s->members[i]);
+  return block;
+}
+
+/* Returns the member of S that holds SECTOR and stores the
+   sector's offset within that member in *MEMBER_SECTOR. */
+static struct block *
+locate (const struct stripe *s, block_sector_t sector,
+        block_sector_t *member_sector)
+{
+  block_sector_t chunk = sector / STRIPE_CHUNK;
+
+  *member_sector = (chunk / s->member_cnt * STRIPE_CHUNK
+                    + sector % STRIPE_CHUNK);
+  return s->members[chunk % s->member_cnt];
+}
+
+/* Wakes up the transfer() that queued chunk request R. */
+static void
+chunk_done (struct block_request *r)
+{
+  sema_up (r->aux);
+}
+
+/* Reads or writes, according to WRITE, the CNT sectors starting
+   at SECTOR between S and BUFFER.  Queues one request per chunk
+   on its member, up to STRIPE_BATCH at a time, and waits for
+   them all; each member's queue merges the chunks that continue
+   each other on it. */
+static void
+transfer (struct stripe *s, block_sector_t sector, block_sector_t cnt,
+          uint8_t *buffer, bool write)
+{
+  struct block_request requests[STRIPE_BATCH];
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  while (cnt > 0)
+    {
+      size_t n, i;
+
+      for (n = 0; n < STRIPE_BATCH && cnt > 0; n++)
+        {
+          struct block_request *r = &requests[n];
+          block_sector_t chunk_left = STRIPE_CHUNK - sector % STRIPE_CHUNK;
+          struct block *member = locate (s, sector, &r->sector);
+
+          r->cnt = cnt < chunk_left ? cnt : chunk_left;
+          r->buffer = buffer;
+          r->write = write;
+          r->done = chunk_done;
+          r->aux = &done;
+          block_submit (member, r);
+
+          sector += r->cnt;
+          cnt -= r->cnt;
+          buffer += r->cnt * BLOCK_SECTOR_SIZE;
+        }
+      for (i = 0; i < n; i++)
+        sema_down (&done);
+    }
+}
+
+/* Reads sector SECTOR from stripe S into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+stripe_read (void *s_, block_sector_t sector, void *buffer)
+{
+  struct stripe *s = s_;
+  block_sector_t member_sector;
+  struct block *member = locate (s, sector, &member_sector);
+
+  block_read (member, member_sector, buffer);
+}
+
+/* Write sector SECTOR to stripe S from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+stripe_write (void *s_, block_sector_t sector, const void *buffer)
+{
+  struct stripe *s = s_;
+  block_sector_t member_sector;
+  struct block *member = locate (s, sector, &member_sector);
+
+  block_write (member, member_sector, buffer);
+}
+
+/* Reads CNT sectors starting at SECTOR from stripe S into
+   BUFFER, from all the members it spans at once. */
+static void
+stripe_read_multiple (void *s_, block_sector_t sector, block_sector_t cnt,
+                      void *buffer)
+{
+  transfer (s_, sector, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SECTOR to stripe S from
+   BUFFER, to all the members it spans at once. */
+static void
+stripe_write_multiple (void *s_, block_sector_t sector, block_sector_t cnt,
+                       const void *buffer)
+{
+  transfer (s_, sector, cnt, (uint8_t *) buffer, true);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_read_multiple,
+    stripe_write_multiple
+  };
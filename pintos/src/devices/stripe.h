@@ -0,0 +1,8 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+#include "devices/block.h"
+
+struct block *stripe_create (enum block_type, const char *names);
+
+#endif /* devices/stripe.h */
@@ -23,6 +23,10 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Number of time-stamp counter cycles per timer tick.
+   Initialized by timer_calibrate(). */
+static uint64_t cycles_per_tick;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -72,6 +76,8 @@ void
 timer_calibrate (void) 
 {
   unsigned high_bit, test_bit;
+  int64_t start;
+  uint64_t cycles;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
@@ -91,9 +97,40 @@ timer_calibrate (void)
     if (!too_many_loops (high_bit | test_bit))
       loops_per_tick |= test_bit;
 
+  /* Time one whole tick with the time-stamp counter. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  cycles = timer_cycles ();
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  cycles_per_tick = timer_cycles () - cycles;
+
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
+/* Returns the processor's time-stamp counter, which counts much
+   faster than the timer ticks; see timer_cycles_to_us(). */
+uint64_t
+timer_cycles (void)
+{
+  uint64_t cycles;
+
+  asm volatile ("rdtsc" : "=A" (cycles));
+  return cycles;
+}
+
+/* Converts a difference of CYCLES between two values returned by
+   timer_cycles() into microseconds. */
+uint64_t
+timer_cycles_to_us (uint64_t cycles)
+{
+  if (cycles_per_tick == 0)
+    return 0;
+  return cycles * (1000000 / TIMER_FREQ) / cycles_per_tick;
+}
+
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) 
@@ -16,6 +16,9 @@ void timer_calibrate (void);
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+uint64_t timer_cycles (void);
+uint64_t timer_cycles_to_us (uint64_t cycles);
+
 /* Struct for use in putting threads to sleep.  Each struct contains a
    semaphore which is downed by the thread, putting the thread to sleep
    until time alarm_tick.  The timer_interrupt function checks at each
@@ -12,6 +12,9 @@
 #include <stdio.h>
 #include <string.h>
 
+/* Number of directory entries read per getdents() call. */
+#define ENTRY_BATCH 32
+
 static bool
 list_dir (const char *dir, bool verbose) 
 {
@@ -24,39 +27,40 @@ list_dir (const char *dir, bool verbose)
 
   if (isdir (dir_fd))
     {
-      char name[READDIR_MAX_LEN];
+      struct dirent ents[ENTRY_BATCH];
+      int ent_cnt, i;
 
       printf ("%s", dir);
       if (verbose)
         printf (" (inumber %d)", inumber (dir_fd));
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
-        {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
+      while ((ent_cnt = getdents (dir_fd, ents, ENTRY_BATCH)) > 0)
+        for (i = 0; i < ent_cnt; i++)
+          {
+            printf ("%s", ents[i].name); 
+            if (verbose) 
+              {
+                char full_name[128];
+                struct stat st;
 
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+                snprintf (full_name, sizeof full_name, "%s/%s",
+                          dir, ents[i].name);
 
-              printf (": ");
-              if (entry_fd != -1)
-                {
-                  if (isdir (entry_fd))
-                    printf ("directory");
-                  else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
-                }
-              else
-                printf ("open failed");
-              close (entry_fd);
-            }
-          printf ("\n");
-        }
+                printf (": ");
+                if (stat (full_name, &st))
+                  {
+                    if (st.is_dir)
+                      printf ("directory");
+                    else
+                      printf ("%d-byte file", st.size);
+                    printf (", inumber %d", st.inumber);
+                  }
+                else
+                  printf ("stat failed");
+              }
+            printf ("\n");
+          }
     }
   else 
     printf ("%s: not a directory\n", dir);
@@ -6,11 +6,62 @@
 #include "threads/thread.h"
 #include "devices/timer.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 struct cached_block block_cache[CACHE_SIZE];
 
 uint8_t cache_hand; // for clock algorithm
 
+static struct cached_block *cache_get (block_sector_t sector, bool read,
+				       const void *fill);
+
+/* Sectors the read-ahead thread reads from disk per command. */
+#define READ_AHEAD_BATCH 8
+static uint8_t read_ahead_buf[READ_AHEAD_BATCH * BLOCK_SECTOR_SIZE];
+
+/* Dirty blocks written back so far, and its value when the
+	read-ahead thread last read a batch: if they differ, a sector in
+	the batch may have been rewritten on disk since*/
+static unsigned write_back_cnt;
+static unsigned read_ahead_write_backs;
+
+/* A write-back queued by flush_blocks(), with its own copy of the
+	data so that the cached block is free for use meanwhile*/
+struct flush_write
+{
+	struct block_request req;
+	uint8_t data[BLOCK_SECTOR_SIZE];
+};
+
+/* One flush at a time uses these. flush_done is upped as each
+	write finishes*/
+static struct lock flush_lock;
+static struct flush_write flush_writes[CACHE_SIZE];
+static struct semaphore flush_done;
+
+static void
+flush_write_done (struct block_request *r UNUSED)
+{
+	sema_up (&flush_done);
+}
+
+/* Access counts of sectors that have left the cache, from which
+	cache_hot_sectors() picks the sectors worth prefetching at the
+	next boot. An entry with a zero count is free. Protected by
+	cache_lock*/
+struct hot_sector
+{
+	block_sector_t sector;
+	unsigned access_cnt;
+};
+
+#define HOT_TABLE_SIZE (2 * CACHE_HOT_MAX)
+static struct hot_sector hot_table[HOT_TABLE_SIZE];
+
+static void hot_record (block_sector_t sector, unsigned access_cnt);
+static void hot_forget (block_sector_t sector);
+
 
 
 void 
@@ -23,16 +74,20 @@ cache_init (void)
 		cond_init (&block_cache[i].r_w_done);
 		block_cache[i].old_sector = -1;
 		block_cache[i].sector = -1;
+		block_cache[i].owner = -1;
 	}
 
 	//first block is preallocated for the free map.
 	// it will not be evicted
 	block_cache[0].sector = 0;
+	block_cache[0].owner = FREE_MAP_SECTOR;
 	block_cache[0].in_use = true;
 	block_cache[0].IO_needed = true;
 
 	cache_hand = 0;
 	lock_init (&cache_lock);
+	lock_init (&flush_lock);
+	sema_init (&flush_done, 0);
 
 	list_init (&read_ahead_queue);
 	lock_init (&read_ahead_lock);
@@ -46,6 +101,7 @@ cache_init (void)
 void 
 write_behind_func (void *aux UNUSED)
 {
+	block_set_io_class (BLOCK_IO_WRITE_BACK);
 	while (true)
 	{
 		timer_sleep (TIMER_FREQ * WRITE_BEHIND_INTERVAL);
@@ -53,12 +109,62 @@ write_behind_func (void *aux UNUSED)
 	}
 }
 
+/* Returns true if SECTOR is cached or being loaded. */
+static bool
+is_cached (block_sector_t sector)
+{
+	bool cached = false;
+	int i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < CACHE_SIZE && !cached; i++)
+		cached = block_cache[i].in_use
+			 && (block_cache[i].sector == sector
+			     || block_cache[i].old_sector == sector);
+	lock_release (&cache_lock);
+	return cached;
+}
+
+/* Loads the CNT sectors starting at SECTOR, at most
+	READ_AHEAD_BATCH, into the cache with one disk command.
+	Sectors at either end that are already cached are left out of
+	the command, and sectors cached meanwhile keep their cached
+	contents. */
+static void
+read_ahead_run (block_sector_t sector, block_sector_t cnt)
+{
+	struct cached_block *b;
+	block_sector_t i;
+
+	ASSERT (cnt <= READ_AHEAD_BATCH);
+	while (cnt > 0 && is_cached (sector))
+	{
+		sector++;
+		cnt--;
+	}
+	while (cnt > 0 && is_cached (sector + cnt - 1))
+		cnt--;
+	if (cnt == 0)
+		return;
+
+	read_ahead_write_backs = write_back_cnt;
+	block_read_multiple (fs_device, sector, cnt, read_ahead_buf);
+	// not cache_insert: read-ahead is not a demand access
+	for (i = 0; i < cnt; i++)
+	{
+		b = cache_get (sector + i, true,
+			       read_ahead_buf + i * BLOCK_SECTOR_SIZE);
+		lock_release (&b->lock);
+	}
+}
+
 void 
 read_ahead_func (void *aux UNUSED)
 {
 	struct list_elem *e;
-	struct cached_block *b;
 	struct queued_sector *queued_sector;
+	block_sector_t i;
+	block_set_io_class (BLOCK_IO_READ_AHEAD);
 	lock_acquire (&read_ahead_lock);
 	while (true)
 	{
@@ -67,8 +173,13 @@ read_ahead_func (void *aux UNUSED)
 			e = list_pop_front (&read_ahead_queue);
 			lock_release (&read_ahead_lock);
 			queued_sector = list_entry (e, struct queued_sector, elem);
-			b = cache_insert (queued_sector->sector);
-			lock_release (&b->lock);
+			for (i = 0; i < queued_sector->cnt; i += READ_AHEAD_BATCH)
+			{
+				block_sector_t cnt = queued_sector->cnt - i;
+				if (cnt > READ_AHEAD_BATCH)
+					cnt = READ_AHEAD_BATCH;
+				read_ahead_run (queued_sector->sector + i, cnt);
+			}
 			free (queued_sector);
 			lock_acquire (&read_ahead_lock);
 		}
@@ -86,16 +197,146 @@ cache_read_ahead (block_sector_t sector)
 	if (qs == NULL)
 		return;
 	qs->sector = sector;
+	qs->cnt = 1;
 	lock_acquire (&read_ahead_lock);
 	list_push_back (&read_ahead_queue, &qs->elem);
 	cond_signal (&read_ahead_go, &read_ahead_lock);
 	lock_release (&read_ahead_lock);
 }
 
+static int
+compare_sectors (const void *a_, const void *b_)
+{
+	const block_sector_t *a = a_;
+	const block_sector_t *b = b_;
+	return *a < *b ? -1 : *a > *b;
+}
 
+/* Queues the CNT sectors in SECTORS for the read-ahead thread.
+	They are sorted and runs of consecutive sectors are queued as
+	one request, so the disk sees a single ascending sweep. Zero
+	(never evicted anyway), duplicate and out of range entries are
+	dropped. SECTORS is sorted in place. */
+void 
+cache_prefetch (block_sector_t *sectors, size_t cnt)
+{
+	struct queued_sector *qs = NULL;
+	struct list runs;
+	size_t i;
+
+	qsort (sectors, cnt, sizeof *sectors, compare_sectors);
+	list_init (&runs);
+	for (i = 0; i < cnt; i++)
+	{
+		block_sector_t sector = sectors[i];
+		if (sector == 0 || sector >= block_size (fs_device)
+		    || (i > 0 && sector == sectors[i - 1]))
+			continue;
+		if (qs != NULL && qs->sector + qs->cnt == sector)
+		{
+			qs->cnt++;
+			continue;
+		}
+		qs = malloc (sizeof (struct queued_sector));
+		if (qs == NULL)
+			break;
+		qs->sector = sector;
+		qs->cnt = 1;
+		list_push_back (&runs, &qs->elem);
+	}
+	if (list_empty (&runs))
+		return;
+
+	lock_acquire (&read_ahead_lock);
+	while (!list_empty (&runs))
+		list_push_back (&read_ahead_queue, list_pop_front (&runs));
+	cond_signal (&read_ahead_go, &read_ahead_lock);
+	lock_release (&read_ahead_lock);
+}
+
+/* Adds ACCESS_CNT accesses to SECTOR's entry in the hot table.
+	If SECTOR has no entry, it takes over the coldest one, provided
+	it has been used more. */
+static void
+hot_record (block_sector_t sector, unsigned access_cnt)
+{
+	struct hot_sector *coldest = &hot_table[0];
+	int i;
+
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+	if (access_cnt == 0)
+		return;
+	for (i = 0; i < HOT_TABLE_SIZE; i++)
+	{
+		struct hot_sector *h = &hot_table[i];
+		if (h->access_cnt > 0 && h->sector == sector)
+		{
+			h->access_cnt += access_cnt;
+			return;
+		}
+		if (h->access_cnt < coldest->access_cnt)
+			coldest = h;
+	}
+	if (access_cnt > coldest->access_cnt)
+	{
+		coldest->sector = sector;
+		coldest->access_cnt = access_cnt;
+	}
+}
+
+/* Drops SECTOR from the hot table, because it has been freed. */
+static void
+hot_forget (block_sector_t sector)
+{
+	int i;
+
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+	for (i = 0; i < HOT_TABLE_SIZE; i++)
+		if (hot_table[i].access_cnt > 0 && hot_table[i].sector == sector)
+			hot_table[i].access_cnt = 0;
+}
+
+/* Orders hot sectors by decreasing access count. */
+static int
+compare_hot (const void *a_, const void *b_)
+{
+	const struct hot_sector *a = a_;
+	const struct hot_sector *b = b_;
+	return a->access_cnt > b->access_cnt ? -1 : a->access_cnt < b->access_cnt;
+}
+
+/* Stores up to MAX of the most frequently accessed sectors, the
+	hottest first, into SECTORS and returns how many were stored.
+	Counts both sectors now in the cache and those evicted since
+	boot. */
+size_t
+cache_hot_sectors (block_sector_t *sectors, size_t max)
+{
+	size_t cnt = 0;
+	int i;
+
+	lock_acquire (&cache_lock);
+	for (i = 1; i < CACHE_SIZE; i++)
+	{
+		struct cached_block *b = &block_cache[i];
+		if (b->in_use && !b->IO_needed)
+		{
+			hot_record (b->sector, b->access_cnt);
+			b->access_cnt = 0;
+		}
+	}
+	qsort (hot_table, HOT_TABLE_SIZE, sizeof *hot_table, compare_hot);
+	for (i = 0; i < HOT_TABLE_SIZE && cnt < max; i++)
+		if (hot_table[i].access_cnt > 0)
+			sectors[cnt++] = hot_table[i].sector;
+	lock_release (&cache_lock);
+	return cnt;
+}
 
 /* Finds a cache block to evict. Runs a simple clock algorithm
-	with accessed bits*/
+	with accessed bits. Blocks with active readers or writers are
+	skipped, so a thread holding one block (see inode_copy_at)
+	never waits on itself to evict it*/
 struct cached_block *
 cache_run_clock (void)
 {
@@ -109,7 +350,7 @@ cache_run_clock (void)
 		b = &block_cache[cache_hand];
 		if (!b->accessed)
 		{
-			if (!b->IO_needed)
+			if (!b->IO_needed && b->active_r_w == 0)
 				return b;
 		}
 		else
@@ -122,6 +363,19 @@ cache_run_clock (void)
 	the lock held. The caller must release the lock*/
 struct cached_block *
 cache_insert (block_sector_t sector)
+{
+	struct cached_block *b = cache_get (sector, true, NULL);
+	b->access_cnt ++;
+	return b;
+}
+
+/* Like cache_insert, but if the sector is not already cached
+	its old contents are not read from disk, for callers about to
+	overwrite the whole sector, unless READ. With READ, FILL, if
+	nonnull, holds the sector's contents as read_ahead_run() read
+	them; they are used unless something was written back since*/
+static struct cached_block *
+cache_get (block_sector_t sector, bool read, const void *fill)
 {
 
 	int i;
@@ -155,9 +409,11 @@ cache_insert (block_sector_t sector)
 			if (b == NULL)
 			{
 				b = cache_run_clock ();
+				hot_record (b->sector, b->access_cnt);
 				b->old_sector = b->sector;
 			}
 			b->sector = sector;
+			b->access_cnt = 0;
 			b->IO_needed = true;
 
 			b->in_use = true;
@@ -177,16 +433,24 @@ cache_insert (block_sector_t sector)
 			}
 			if (b->IO_needed)
 			{
+				// writing back the old sector cannot stale FILL
+				bool fresh = write_back_cnt == read_ahead_write_backs;
+
 				ASSERT (b->active_r_w == 0);
 				if (b->dirty)
 				{
 					block_write (fs_device, b->old_sector, b->data);
+					write_back_cnt ++;
 				}
-				block_read (fs_device, b->sector, b->data);
+				if (read && fill != NULL && fresh)
+					memcpy (b->data, fill, BLOCK_SECTOR_SIZE);
+				else if (read)
+					block_read (fs_device, b->sector, b->data);
 				b->old_sector = -1;
 				b->IO_needed = false;
 				b->accessed = false;
 				b->dirty = false;
+				b->owner = -1;
 			}
 		}
 
@@ -200,40 +464,223 @@ cache_insert (block_sector_t sector)
 	return b;	
 }
 
+/* Drops an active reader or writer taken on B after cache_insert */
+static void
+cache_release (struct cached_block *b)
+{
+	lock_acquire (&b->lock);
+	b->active_r_w --;
+	if (b->active_r_w == 0)
+		cond_broadcast (&b->r_w_done, &b->lock);
+	lock_release (&b->lock);
+}
 
+/* Reads SIZE bytes at offset OFS within SECTOR into BUFFER
+	through the cache. */
 void 
-cache_flush (void)
+cache_read_at (block_sector_t sector, void *buffer, int ofs, int size)
+{
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+	struct cached_block *b = cache_insert (sector);
+	b->active_r_w ++;
+	lock_release (&b->lock);
+
+	memcpy (buffer, b->data + ofs, size);
+	b->accessed = true;
+
+	cache_release (b);
+}
+
+/* Copies SIZE bytes from BUFFER to offset OFS within the cached
+	copy of SECTOR and marks it dirty, on behalf of the inode at
+	sector OWNER. The disk is written later, by write-behind or a
+	flush*/
+void 
+cache_write_at (block_sector_t sector, const void *buffer, int ofs, int size,
+		block_sector_t owner)
+{
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+	// a whole-sector write needs no read, but then must fill the
+	// block before anyone else can see it
+	if (size == BLOCK_SECTOR_SIZE)
+	{
+		struct cached_block *b = cache_get (sector, false, NULL);
+		b->access_cnt ++;
+		memcpy (b->data, buffer, BLOCK_SECTOR_SIZE);
+		b->dirty = true;
+		b->owner = owner;
+		lock_release (&b->lock);
+		return;
+	}
+
+	struct cached_block *b = cache_insert (sector);
+	b->active_r_w ++;
+	lock_release (&b->lock);
+
+	memcpy (b->data + ofs, buffer, size);
+	b->dirty = true;
+	b->owner = owner;
+
+	cache_release (b);
+}
+
+/* Reads a whole SECTOR into BUFFER through the cache. */
+void 
+cache_read (block_sector_t sector, void *buffer)
+{
+	cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Overwrites all of SECTOR with BUFFER in the cache. */
+void 
+cache_write (block_sector_t sector, const void *buffer, block_sector_t owner)
+{
+	cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE, owner);
+}
+
+/* Fills SECTOR with zeros in the cache, without reading it from
+	disk first. */
+void 
+cache_zero (block_sector_t sector, block_sector_t owner)
+{
+	struct cached_block *b = cache_get (sector, false, NULL);
+
+	memset (b->data, 0, BLOCK_SECTOR_SIZE);
+	b->dirty = true;
+	b->owner = owner;
+	lock_release (&b->lock);
+}
+
+/* Drops SECTOR from the cache without writing it back, because
+	it has been freed. */
+void 
+cache_discard (block_sector_t sector)
 {
 	int i;
-	struct cached_block *b;
-	block_sector_t sector;
-	for (i = 0; i < CACHE_SIZE; i++)
+	struct cached_block *b = NULL;
+
+	lock_acquire (&cache_lock);
+	hot_forget (sector);
+	for (i = 1; i < CACHE_SIZE; i++)
 	{
-		b = &block_cache[i];
-		lock_acquire (&b->lock);
-		while (b->active_r_w > 0)
+		if (block_cache[i].in_use && block_cache[i].sector == sector)
 		{
-			cond_wait (&b->r_w_done, &b->lock);
-		}
-		if (b->in_use && b->dirty)
-		{
-			sector = b->sector;
-			if (b->IO_needed)
-				sector = b->old_sector;
-			block_write (fs_device, sector, b->data);
-			b->dirty = false;
+			b = &block_cache[i];
+			break;
 		}
-		lock_release (&b->lock);
 	}
-}
+	lock_release (&cache_lock);
+	if (b == NULL)
+		return;
 
+	lock_acquire (&b->lock);
+	while (b->active_r_w > 0)
+	{
+		cond_wait (&b->r_w_done, &b->lock);
+	}
+	lock_acquire (&cache_lock);
+	if (b->in_use && b->sector == sector && !b->IO_needed)
+	{
+		b->in_use = false;
+		b->sector = -1;
+		b->dirty = false;
+		b->owner = -1;
+	}
+	lock_release (&cache_lock);
+	lock_release (&b->lock);
+}
 
+/* Snapshots B into W and queues W's write to disk if B is dirty,
+	and returns whether it did. If B is being switched to another
+	sector, the dirty data belongs to the old one. The block layer
+	writes overlapping requests in order, so a later write-back or
+	read of the same sector cannot overtake W*/
+static bool
+flush_block (struct cached_block *b, struct flush_write *w)
+{
+	bool queued = false;
 
+	lock_acquire (&b->lock);
+	while (b->active_r_w > 0)
+	{
+		cond_wait (&b->r_w_done, &b->lock);
+	}
+	if (b->in_use && b->dirty)
+	{
+		memcpy (w->data, b->data, BLOCK_SECTOR_SIZE);
+		w->req.sector = b->IO_needed ? b->old_sector : b->sector;
+		w->req.cnt = 1;
+		w->req.buffer = w->data;
+		w->req.write = true;
+		w->req.done = flush_write_done;
+		block_submit (fs_device, &w->req);
+		write_back_cnt ++;
+		b->dirty = false;
+		queued = true;
+	}
+	lock_release (&b->lock);
+	return queued;
+}
 
+/* Writes back every dirty block for which MATCH (B, ARG) is true.
+	All the writes are queued before waiting for any, so that the
+	block layer can sort and merge them*/
+static void
+flush_blocks (bool (*match) (struct cached_block *, block_sector_t),
+	      block_sector_t arg)
+{
+	int i;
+	int queued = 0;
 
+	lock_acquire (&flush_lock);
+	for (i = 0; i < CACHE_SIZE; i++)
+	{
+		struct cached_block *b = &block_cache[i];
+		if (match (b, arg) && flush_block (b, &flush_writes[queued]))
+			queued ++;
+	}
+	while (queued-- > 0)
+		sema_down (&flush_done);
+	lock_release (&flush_lock);
+}
 
+static bool
+match_any (struct cached_block *b UNUSED, block_sector_t arg UNUSED)
+{
+	return true;
+}
 
+void 
+cache_flush (void)
+{
+	flush_blocks (match_any, 0);
+}
 
+/* Writes back the dirty data and index blocks of the inode at
+	sector OWNER, but not the inode sector itself */
+static bool
+match_owner (struct cached_block *b, block_sector_t owner)
+{
+	return b->dirty && b->owner == owner && b->sector != owner;
+}
 
+void 
+cache_flush_owner (block_sector_t owner)
+{
+	flush_blocks (match_owner, owner);
+}
 
+/* Writes back SECTOR if it is cached and dirty */
+static bool
+match_sector (struct cached_block *b, block_sector_t sector)
+{
+	return b->dirty && (b->IO_needed ? b->old_sector : b->sector) == sector;
+}
 
+void 
+cache_flush_sector (block_sector_t sector)
+{
+	flush_blocks (match_sector, sector);
+}
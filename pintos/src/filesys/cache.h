@@ -5,13 +5,16 @@
 #include "threads/synch.h"
 
 #define CACHE_SIZE 65 // 64 sectors + free map
-#define WRITE_BEHIND_INTERVAL 1 //in seconds
+#define WRITE_BEHIND_INTERVAL 5 //in seconds; use fsync for durability sooner
+#define CACHE_HOT_MAX (CACHE_SIZE - 1) // hot sectors worth prefetching at boot
 
 struct cached_block
 {
 	uint8_t data[BLOCK_SECTOR_SIZE];
 	block_sector_t sector;
 	block_sector_t old_sector;
+	block_sector_t owner; // inode sector whose data was last written here
+	unsigned access_cnt; // demand accesses since the sector was loaded
 	bool in_use;
 	int active_r_w;
 	bool accessed;
@@ -24,6 +27,7 @@ struct cached_block
 struct queued_sector
 {
 	block_sector_t sector;
+	block_sector_t cnt; // consecutive sectors starting at sector
 	struct list_elem elem;
 };
 
@@ -33,6 +37,8 @@ struct condition read_ahead_go;
 
 void read_ahead_func (void *aux);
 void cache_read_ahead (block_sector_t sector);
+void cache_prefetch (block_sector_t *sectors, size_t cnt);
+size_t cache_hot_sectors (block_sector_t *sectors, size_t max);
 
 struct cached_block block_cache[CACHE_SIZE];
 struct lock cache_lock;
@@ -40,7 +46,17 @@ struct lock cache_lock;
 void cache_init (void);
 struct cached_block *cache_run_clock (void);
 void cache_flush (void);
+void cache_flush_owner (block_sector_t owner);
+void cache_flush_sector (block_sector_t sector);
 struct cached_block *cache_insert (block_sector_t sector);
+void cache_read (block_sector_t sector, void *buffer);
+void cache_write (block_sector_t sector, const void *buffer,
+		  block_sector_t owner);
+void cache_read_at (block_sector_t sector, void *buffer, int ofs, int size);
+void cache_write_at (block_sector_t sector, const void *buffer, int ofs,
+		     int size, block_sector_t owner);
+void cache_zero (block_sector_t sector, block_sector_t owner);
+void cache_discard (block_sector_t sector);
 void write_behind_func (void *aux);
 
 
@@ -0,0 +1,143 @@
+#include "filesys/defrag.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Ticks to sleep each time foreground I/O is seen. */
+#define DEFRAG_BACKOFF (TIMER_FREQ / 10)
+
+/* A directory still to be walked. */
+struct pending_dir
+  {
+    struct list_elem elem;
+    block_sector_t inumber;
+  };
+
+static bool running;                /* Defragmenter thread started? */
+static volatile bool stopping;      /* Asked to stop by defrag_stop()? */
+static struct semaphore finished;   /* Upped when the thread exits. */
+static unsigned last_io_cnt;        /* inode_io_cnt() at last look. */
+
+/* Totals for the summary printed at the end. */
+static size_t file_cnt, moved_cnt, runs_before, runs_after;
+
+static void defrag_thread (void *);
+static void defrag_inode (struct inode *, struct list *pending);
+
+/* Starts defragmenting the file system in the background, unless
+   it already is being. */
+void
+defrag_start (void)
+{
+  if (running)
+    return;
+  running = true;
+  stopping = false;
+  sema_init (&finished, 0);
+  last_io_cnt = inode_io_cnt ();
+  if (thread_create ("defrag", PRI_MIN, defrag_thread, NULL) == TID_ERROR)
+    running = false;
+}
+
+/* Stops the defragmenter, if it is running, and waits for it to
+   leave the file system consistent. */
+void
+defrag_stop (void)
+{
+  if (!running)
+    return;
+  stopping = true;
+  sema_down (&finished);
+  running = false;
+}
+
+/* Waits until no inode I/O has happened for DEFRAG_BACKOFF ticks.
+   Returns false if the defragmenter should stop instead. */
+bool
+defrag_pace (void)
+{
+  unsigned cnt;
+
+  while (!stopping && (cnt = inode_io_cnt ()) != last_io_cnt)
+    {
+      last_io_cnt = cnt;
+      timer_sleep (DEFRAG_BACKOFF);
+    }
+  return !stopping;
+}
+
+/* Walks the directory tree breadth first, without recursion, so
+   deep trees cannot overflow the kernel stack. */
+static void
+defrag_thread (void *aux UNUSED)
+{
+  struct list pending;
+
+  list_init (&pending);
+  file_cnt = moved_cnt = runs_before = runs_after = 0;
+  defrag_inode (inode_open (ROOT_DIR_SECTOR), &pending);
+  while (!list_empty (&pending))
+    {
+      struct pending_dir *p = list_entry (list_pop_front (&pending),
+                                          struct pending_dir, elem);
+      struct dir *dir = NULL;
+      char name[NAME_MAX + 1];
+
+      if (!stopping)
+        dir = dir_open (inode_open (p->inumber));
+      free (p);
+      if (dir == NULL)
+        continue;
+      while (defrag_pace ())
+        {
+          unsigned before = inode_io_cnt ();
+          struct inode *inode;
+          bool found;
+
+          if (!dir_readdir (dir, name))
+            break;
+          found = dir_lookup (dir, name, &inode);
+
+          /* Our own directory reads are not foreground I/O. */
+          last_io_cnt += inode_io_cnt () - before;
+          if (found)
+            defrag_inode (inode, &pending);
+        }
+      dir_close (dir);
+    }
+
+  printf ("defrag: %zu files, %zu moved, %zu runs before, %zu after\n",
+          file_cnt, moved_cnt, runs_before, runs_after);
+  sema_up (&finished);
+}
+
+/* Defragments INODE, counts it and closes it.  A directory is
+   added to PENDING to be walked later. */
+static void
+defrag_inode (struct inode *inode, struct list *pending)
+{
+  if (inode == NULL)
+    return;
+  if (inode_is_directory (inode))
+    {
+      struct pending_dir *p = malloc (sizeof *p);
+      if (p != NULL)
+        {
+          p->inumber = inode_get_inumber (inode);
+          list_push_back (pending, &p->elem);
+        }
+    }
+  file_cnt++;
+  runs_before += inode_fragments (inode);
+  if (inode_defrag (inode))
+    moved_cnt++;
+  runs_after += inode_fragments (inode);
+  inode_close (inode);
+}
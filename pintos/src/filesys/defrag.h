@@ -0,0 +1,18 @@
+#ifndef FILESYS_DEFRAG_H
+#define FILESYS_DEFRAG_H
+
+#include <stdbool.h>
+
+/* Background defragmenter.  Walks the directory tree from the
+   root and moves each fragmented file or directory that nobody
+   else has open into one contiguous run with inode_defrag(),
+   backing off while other threads do file I/O. */
+
+/* Sectors inode_defrag() copies between calls to defrag_pace(). */
+#define DEFRAG_CHUNK 16
+
+void defrag_start (void);
+void defrag_stop (void);
+bool defrag_pace (void);
+
+#endif /* filesys/defrag.h */
@@ -2,8 +2,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <round.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/procfs.h"
+#include "filesys/tmpfs.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "free-map.h"
@@ -22,8 +25,34 @@ struct dir_entry
     block_sector_t inode_sector;        /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
+    bool is_dir;                        /* Is the entry a directory? */
   };
 
+/* Number of entries a directory grows by when it has no free
+   slot left, i.e. about one sector's worth, so that adding many
+   files to a directory extends it once per sector rather than
+   once per file. */
+#define DIR_GROW_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+static bool grow (struct dir *, const struct dir_entry *, off_t ofs);
+
+/* Returns the inode number of the root of the file system
+   mounted as NAME in DIR, or 0 if NAME is not a mount point.
+   Mount points have no entry in the root directory: lookups are
+   redirected here, so they do not show up when reading the root
+   directory and nothing on disk can shadow them. */
+static block_sector_t
+mount_point (const struct dir *dir, const char *name)
+{
+  if (inode_get_inumber (dir->inode) != ROOT_DIR_SECTOR)
+    return 0;
+  if (!strcmp (name, TMPFS_MOUNT_NAME))
+    return TMPFS_ROOT;
+  if (!strcmp (name, PROCFS_MOUNT_NAME))
+    return PROCFS_ROOT;
+  return 0;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -38,8 +67,8 @@ dir_create (block_sector_t sector, block_sector_t parent_sector, size_t entry_cn
 
   struct dir *dir = dir_open (inode);
 
-  dir_add (dir, ".", sector);
-  dir_add (dir, "..", parent_sector);
+  dir_add (dir, ".", sector, true);
+  dir_add (dir, "..", parent_sector, true);
   dir_close (dir);
   return true;
 }
@@ -139,7 +168,9 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
+  if (mount_point (dir, name) != 0)
+    *inode = inode_open (mount_point (dir, name));
+  else if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
@@ -149,12 +180,13 @@ dir_lookup (const struct dir *dir, const char *name,
 
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
-   INODE_SECTOR.
+   INODE_SECTOR, and IS_DIR tells whether it is a directory.
    Returns true if successful, false on failure.
    Fails if NAME is invalid (i.e. too long) or a disk or memory
    error occurs. */
 bool
-dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+dir_add (struct dir *dir, const char *name, block_sector_t inode_sector,
+         bool is_dir)
 {
   struct dir_entry e;
   off_t ofs;
@@ -168,31 +200,78 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
     return false;
 
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  if (mount_point (dir, name) != 0 || lookup (dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
+  /* Set OFS to offset of free slot.  The search starts at the
+     inode's free-slot hint, since no slot before it is free.
      If there are no free slots, then it will be set to the
      current end-of-file.
      
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  for (ofs = inode_get_free_slot (dir->inode);
+       inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (!e.in_use)
       break;
 
-  /* Write slot. */
+  /* Write slot, growing the directory if it is full. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  e.is_dir = is_dir;
+  if (ofs < inode_length (dir->inode))
+    success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  else
+    success = grow (dir, &e, ofs);
+  if (success)
+    inode_set_free_slot (dir->inode, ofs + sizeof e);
 
  done:
   return success;
 }
 
+/* Stores an entry for NAME, naming INODE_SECTOR, in slot IDX of
+   BUF, which holds SIZE bytes of directory contents being built
+   in memory, as procfs does.  Returns the length of the contents
+   through that slot, or 0 if the slot does not fit in BUF. */
+off_t
+dir_put_entry (void *buf, size_t size, size_t idx, const char *name,
+               block_sector_t inode_sector, bool is_dir)
+{
+  struct dir_entry *e = (struct dir_entry *) buf + idx;
+
+  if ((idx + 1) * sizeof *e > size)
+    return 0;
+  memset (e, 0, sizeof *e);
+  e->in_use = true;
+  strlcpy (e->name, name, sizeof e->name);
+  e->inode_sector = inode_sector;
+  e->is_dir = is_dir;
+  return (idx + 1) * sizeof *e;
+}
+
+/* Appends entry E to DIR at OFS, its current end-of-file,
+   followed by enough free entries to make up DIR_GROW_ENTRIES.
+   Returns true if successful, false on failure. */
+static bool
+grow (struct dir *dir, const struct dir_entry *e, off_t ofs)
+{
+  struct dir_entry *chunk;
+  off_t size = DIR_GROW_ENTRIES * sizeof *chunk;
+  bool success;
+
+  chunk = calloc (DIR_GROW_ENTRIES, sizeof *chunk);
+  if (chunk == NULL)
+    return false;
+  chunk[0] = *e;
+  success = inode_write_at (dir->inode, chunk, size, ofs) == size;
+  free (chunk);
+  return success;
+}
+
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
    which occurs only if there is no file with the given NAME. */
@@ -223,6 +302,8 @@ dir_remove (struct dir *dir, const char *name)
 
   /* Remove inode. */
   inode_remove (inode);
+  if (ofs < inode_get_free_slot (dir->inode))
+    inode_set_free_slot (dir->inode, ofs);
   success = true;
 
  done:
@@ -256,6 +337,60 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   return false;
 }
 
+/* Most entries that start within one sector. */
+#define SECTOR_ENTRIES DIV_ROUND_UP (BLOCK_SECTOR_SIZE, \
+                                     sizeof (struct dir_entry))
+
+/* Reads up to CNT directory entries from DIR, starting at DIR's
+   current position, into ENTS.  Entries do not divide sectors
+   evenly, so each read takes the entries that start in one
+   sector, the last of which may end in the next, rather than
+   reading entries one by one.  Returns the number of entries
+   stored, which is 0 once the directory contains no more
+   entries, or -1 if memory allocation fails. */
+int
+dir_readdir_many (struct dir *dir, struct dirent *ents, int cnt)
+{
+  struct dir_entry *buf;
+  int n = 0;
+
+  buf = malloc (SECTOR_ENTRIES * sizeof *buf);
+  if (buf == NULL)
+    return -1;
+
+  dir_lock (dir);
+  while (n < cnt)
+  {
+    off_t sector_end = ROUND_UP (dir->pos + 1, BLOCK_SECTOR_SIZE);
+    size_t want = DIV_ROUND_UP (sector_end - dir->pos, sizeof *buf);
+    off_t bytes = inode_read_at (dir->inode, buf, want * sizeof *buf,
+                                 dir->pos);
+    int entry_cnt = bytes / sizeof *buf;
+    int i;
+
+    if (entry_cnt == 0)
+      break;
+    for (i = 0; i < entry_cnt && n < cnt; i++)
+    {
+      struct dir_entry *e = &buf[i];
+
+      dir->pos += sizeof *e;
+      if ((e->in_use)
+          && strcmp (e->name, ".")
+          && strcmp (e->name, ".."))
+        {
+          ents[n].inumber = e->inode_sector;
+          ents[n].is_dir = e->is_dir;
+          strlcpy (ents[n].name, e->name, NAME_MAX + 1);
+          n++;
+        }
+    }
+  }
+  dir_unlock (dir);
+
+  free (buf);
+  return n;
+}
 
 /* Takes a full pathname and fills in the name of the last token and 
   it's containing directory.
@@ -376,11 +511,11 @@ dir_create_pathname (char *pathname)
   block_sector_t inode_sector = 0;
 
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  && filesys_alloc_inumber (dir, &inode_sector)
                   && dir_create (inode_sector, parent_sector, 0)
-                  && dir_add (dir, name, inode_sector));
+                  && dir_add (dir, name, inode_sector, true));
   if (!success && inode_sector != 0) 
-    free_map_release (inode_sector, 1);
+    filesys_free_inumber (inode_sector);
 
   dir_unlock (dir);
   dir_close (dir);
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/block.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
    This is the traditional UNIX maximum length.
@@ -13,6 +14,15 @@
 
 struct inode;
 
+/* A directory entry as returned by dir_readdir_many().
+   Must match struct dirent in lib/user/syscall.h. */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool is_dir;                        /* Is the entry a directory? */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, block_sector_t parent_sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
@@ -23,9 +33,12 @@ struct inode *dir_get_inode (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
-bool dir_add (struct dir *, const char *name, block_sector_t);
+bool dir_add (struct dir *, const char *name, block_sector_t, bool is_dir);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+int dir_readdir_many (struct dir *, struct dirent *, int cnt);
+off_t dir_put_entry (void *buf, size_t size, size_t idx, const char *name,
+                     block_sector_t inode_sector, bool is_dir);
 
 bool dir_set_current_dir (char *pathname);
 bool dir_create_pathname (char *pathname);
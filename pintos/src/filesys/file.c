@@ -113,6 +113,44 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies SIZE bytes from SRC into DST, starting at each file's
+   current position, entirely within the buffer cache.
+   Returns the number of bytes actually copied, which may be
+   less than SIZE if end of SRC is reached, or -1 if the two
+   ranges overlap within the same file.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied = inode_copy_at (dst->inode, dst->pos,
+                                      src->inode, src->pos, size);
+  if (bytes_copied > 0) 
+    {
+      src->pos += bytes_copied;
+      dst->pos += bytes_copied;
+    }
+  return bytes_copied;
+}
+
+/* Reserves disk space for the first SIZE bytes of FILE without
+   changing its length.
+   Returns true if successful, false if the disk is full. */
+bool
+file_allocate (struct file *file, off_t size) 
+{
+  return inode_allocate (file->inode, size);
+}
+
+/* Sets the length of FILE to SIZE bytes, zero-filling or
+   releasing space at the end as needed.  The file's current
+   position is unaffected.
+   Returns true if successful, false otherwise. */
+bool
+file_truncate (struct file *file, off_t size) 
+{
+  return inode_truncate (file->inode, size);
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -5,13 +5,26 @@
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/defrag.h"
 #include "filesys/directory.h"
+#include "filesys/procfs.h"
+#include "filesys/tmpfs.h"
 #include "cache.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* The hot sector list file holds HOT_LIST_MAGIC followed by up
+   to CACHE_HOT_MAX sector numbers, padded with zeros.  Its
+   magic number guards against a disk formatted before the file
+   existed, whose sector HOT_LIST_SECTOR belongs to another file. */
+#define HOT_LIST_MAGIC 0x484f5453
+static bool hot_list_valid;
+
 static void do_format (void);
+static struct inode *lookup_pathname (const char *pathname);
+static void load_hot_list (void);
+static void save_hot_list (void);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -30,6 +43,11 @@ filesys_init (bool format)
     do_format ();
 
   free_map_open ();
+  load_hot_list ();
+
+  tmpfs_init ();
+  if (!dir_create (TMPFS_ROOT, ROOT_DIR_SECTOR, 0))
+    PANIC ("tmpfs root directory creation failed");
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -37,6 +55,8 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  defrag_stop ();
+  save_hot_list ();
   cache_flush ();
   free_map_close ();
 }
@@ -70,11 +90,11 @@ filesys_create (const char *pathname, off_t initial_size)
 
   bool success = (dir != NULL
                   && !inode_is_removed (dir_get_inode (dir))
-                  && free_map_allocate (1, &inode_sector)
+                  && filesys_alloc_inumber (dir, &inode_sector)
                   && inode_create (inode_sector, initial_size, false)
-                  && dir_add (dir, name, inode_sector));
+                  && dir_add (dir, name, inode_sector, false));
   if (!success && inode_sector != 0) 
-    free_map_release (inode_sector, 1);
+    filesys_free_inumber (inode_sector);
   dir_unlock (dir);
   dir_close (dir);
 
@@ -88,6 +108,47 @@ filesys_create (const char *pathname, off_t initial_size)
    or if an internal memory allocation fails. */
 void *
 filesys_open (const char *pathname, bool *is_dir)
+{
+  struct inode *inode = lookup_pathname (pathname);
+
+  if (inode == NULL)
+    return NULL;
+
+  if (inode_is_directory (inode))
+  {
+    if (is_dir != NULL)
+      *is_dir = true;
+    return (void *)dir_open (inode);
+  }
+  else
+  {
+    if (is_dir != NULL)
+      *is_dir = false;
+    return (void *)file_open (inode);
+  }
+}
+
+/* Stores the metadata of the file or directory with the given
+   NAME into ST, without opening it as a file.
+   Returns true if successful, false if no file named NAME
+   exists. */
+bool
+filesys_stat (const char *pathname, struct stat *st)
+{
+  struct inode *inode = lookup_pathname (pathname);
+
+  if (inode == NULL)
+    return false;
+  inode_stat (inode, st);
+  inode_close (inode);
+  return true;
+}
+
+/* Resolves PATHNAME and returns its inode, which the caller
+   must close, or a null pointer if it does not exist.
+   A trailing '/' only matches a directory. */
+static struct inode *
+lookup_pathname (const char *pathname)
 {
   char name[NAME_MAX + 1];
   struct dir *dir;
@@ -110,23 +171,13 @@ filesys_open (const char *pathname, bool *is_dir)
   dir_unlock (dir);
   dir_close (dir);
 
-  if (inode == NULL)
-    return NULL;
-
-  if (inode_is_directory (inode))
-  {
-    if (is_dir != NULL)
-      *is_dir = true;
-    return (void *)dir_open (inode);
-  }
-  else
+  if (inode != NULL && !inode_is_directory (inode)
+      && pathname[strlen (pathname)- 1] == '/')
   {
-    if (pathname[strlen (pathname)- 1] == '/')
-      return NULL;
-    if (is_dir != NULL)
-      *is_dir = false;
-    return (void *)file_open (inode);
+    inode_close (inode);
+    return NULL;
   }
+  return inode;
 }
 
 /* Deletes the file or directory named NAME.
@@ -208,6 +259,33 @@ filesys_remove (const char *pathname)
   return success;
 }
 
+/* Allocates an inode number for a new file or directory in DIR:
+   a free sector if DIR is on disk, a tmpfs inode number if it is
+   under the tmpfs mount point.  Returns false if none is left, or
+   if DIR is under /proc, which is read-only. */
+bool
+filesys_alloc_inumber (struct dir *dir, block_sector_t *inumberp)
+{
+  block_sector_t parent = inode_get_inumber (dir_get_inode (dir));
+
+  if (procfs_is_inumber (parent))
+    return false;
+  if (tmpfs_is_inumber (parent))
+    return tmpfs_alloc (inumberp);
+  return free_map_allocate (1, inumberp);
+}
+
+/* Frees INUMBER, allocated with filesys_alloc_inumber(), when
+   creating its file or directory failed. */
+void
+filesys_free_inumber (block_sector_t inumber)
+{
+  if (tmpfs_is_inumber (inumber))
+    tmpfs_free (tmpfs_lookup (inumber));
+  else
+    free_map_release (inumber, 1);
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
@@ -216,6 +294,56 @@ do_format (void)
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  if (!inode_create (HOT_LIST_SECTOR, 0, false))
+    PANIC ("hot sector list creation failed");
   free_map_close ();
   printf ("done.\n");
 }
+
+/* Reads the sectors that were hottest when the file system was
+   last shut down and prefetches them into the buffer cache in
+   the background, so that the first accesses after booting hit
+   the cache much as they would in steady state. */
+static void
+load_hot_list (void)
+{
+  block_sector_t list[CACHE_HOT_MAX + 1];
+  struct inode *inode;
+  off_t size;
+
+  inode = inode_open (HOT_LIST_SECTOR);
+  if (inode == NULL)
+    return;
+  size = inode_read_at (inode, list, sizeof list, 0);
+  inode_close (inode);
+
+  if (size == 0)
+    hot_list_valid = true;
+  else if (size == sizeof list && list[0] == HOT_LIST_MAGIC)
+    {
+      hot_list_valid = true;
+      cache_prefetch (list + 1, CACHE_HOT_MAX);
+    }
+}
+
+/* Records the currently hottest sectors for load_hot_list() to
+   prefetch at the next boot. */
+static void
+save_hot_list (void)
+{
+  block_sector_t list[CACHE_HOT_MAX + 1];
+  struct inode *inode;
+  size_t cnt;
+
+  if (!hot_list_valid)
+    return;
+  list[0] = HOT_LIST_MAGIC;
+  cnt = cache_hot_sectors (list + 1, CACHE_HOT_MAX);
+  memset (list + 1 + cnt, 0, (CACHE_HOT_MAX - cnt) * sizeof *list);
+
+  inode = inode_open (HOT_LIST_SECTOR);
+  if (inode == NULL)
+    return;
+  inode_write_at (inode, list, sizeof list, 0);
+  inode_close (inode);
+}
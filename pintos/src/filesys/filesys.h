@@ -2,11 +2,16 @@
 #define FILESYS_FILESYS_H
 
 #include <stdbool.h>
+#include "devices/block.h"
 #include "filesys/off_t.h"
 
+struct dir;
+struct stat;
+
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define HOT_LIST_SECTOR 2       /* Hot sector list file inode sector. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
@@ -16,5 +21,8 @@ void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 void *filesys_open (const char *name, bool *is_dir);
 bool filesys_remove (const char *name);
+bool filesys_stat (const char *name, struct stat *);
+bool filesys_alloc_inumber (struct dir *, block_sector_t *);
+void filesys_free_inumber (block_sector_t);
 
 #endif /* filesys/filesys.h */
@@ -1,15 +1,40 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ustar.h>
+#include "filesys/defrag.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Pages of file data fsutil_extract() moves per batch. */
+#define EXTRACT_BATCH_PAGES 4
+#define EXTRACT_BATCH_SECTORS (EXTRACT_BATCH_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A block I/O trace on the scratch device is a header sector
+   followed by the entries, as returned by block_trace_read(). */
+#define TRACE_MAGIC 0x43525442          /* "BTRC". */
+struct trace_header
+  {
+    uint32_t magic;                     /* TRACE_MAGIC. */
+    uint32_t cnt;                       /* Number of entries. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 8];
+  };
+
+/* fsutil_replay() keeps up to REPLAY_DEPTH requests of up to
+   REPLAY_PAGES pages each in flight. */
+#define REPLAY_DEPTH 4
+#define REPLAY_PAGES 8
+#define REPLAY_MAX_SECTORS (REPLAY_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
 
 /* List files in the root directory. */
 void
@@ -66,8 +91,23 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Reports how fast fsutil_extract() moved FILE_CNT files of
+   BYTES bytes in total in TICKS timer ticks. */
+static void
+print_throughput (int file_cnt, long long bytes, int64_t ticks)
+{
+  long long ms = ticks * 1000 / TIMER_FREQ;
+
+  printf ("Extracted %d files, %lld bytes in %lld ms", file_cnt, bytes, ms);
+  if (ms > 0)
+    printf (" (%lld kB/s)", bytes * 1000 / 1024 / ms);
+  printf ("\n");
+}
+
 /* Extracts a ustar-format tar archive from the scratch block
-   device into the Pintos file system. */
+   device into the Pintos file system.  Each file's space is
+   reserved up front in one contiguous allocation, and its data
+   is streamed EXTRACT_BATCH_SECTORS sectors at a time. */
 void
 fsutil_extract (char **argv UNUSED) 
 {
@@ -75,11 +115,14 @@ fsutil_extract (char **argv UNUSED)
 
   struct block *src;
   void *header, *data;
+  int64_t start;
+  long long total_bytes = 0;
+  int file_cnt = 0;
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
-  if (header == NULL || data == NULL)
+  data = palloc_get_multiple (PAL_ASSERT, EXTRACT_BATCH_PAGES);
+  if (header == NULL)
     PANIC ("couldn't allocate buffers");
 
   /* Open source block device. */
@@ -89,6 +132,7 @@ fsutil_extract (char **argv UNUSED)
 
   printf ("Extracting ustar archive from scratch device "
           "into file system...\n");
+  start = timer_ticks ();
 
   for (;;)
     {
@@ -114,22 +158,34 @@ fsutil_extract (char **argv UNUSED)
         {
           struct file *dst;
 
-          printf ("Putting '%s' into the file system...\n", file_name);
+          printf ("Putting '%s' (%d bytes) into the file system...\n",
+                  file_name, size);
 
-          /* Create destination file. */
-          if (!filesys_create (file_name, size))
+          /* Create destination file and reserve its space. */
+          if (!filesys_create (file_name, 0))
             PANIC ("%s: create failed", file_name);
           dst = (struct file *)filesys_open (file_name, NULL);
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
+          if (!file_allocate (dst, size))
+            PANIC ("%s: out of space for %d bytes", file_name, size);
+          total_bytes += size;
+          file_cnt++;
 
           /* Do copy. */
           while (size > 0)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
-                                : size);
-              block_read (src, sector++, data);
+              int batch_sectors = DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+              int chunk_size;
+
+              if (batch_sectors > EXTRACT_BATCH_SECTORS)
+                batch_sectors = EXTRACT_BATCH_SECTORS;
+              chunk_size = batch_sectors * BLOCK_SECTOR_SIZE;
+              if (chunk_size > size)
+                chunk_size = size;
+
+              block_read_multiple (src, sector, batch_sectors, data);
+              sector += batch_sectors;
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -140,6 +196,7 @@ fsutil_extract (char **argv UNUSED)
           file_close (dst);
         }
     }
+  print_throughput (file_cnt, total_bytes, timer_elapsed (start));
 
   /* Erase the ustar header from the start of the block device,
      so that the extraction operation is idempotent.  We erase
@@ -150,7 +207,7 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
-  free (data);
+  palloc_free_multiple (data, EXTRACT_BATCH_PAGES);
   free (header);
 }
 
@@ -220,3 +277,206 @@ fsutil_append (char **argv)
   file_close (src);
   free (buffer);
 }
+
+/* Stops block I/O tracing and writes the traced requests to the
+   scratch device, for fsutil_replay() to read back, possibly at
+   a later boot. */
+void
+fsutil_trace_dump (char **argv UNUSED)
+{
+  struct trace_header *header;
+  struct block_trace_entry *entries;
+  struct block *dst;
+  block_sector_t sectors;
+  size_t cnt;
+
+  block_trace_stop ();
+  dst = block_get_role (BLOCK_SCRATCH);
+  if (dst == NULL)
+    PANIC ("couldn't open scratch device");
+  header = calloc (1, sizeof *header);
+  entries = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, BLOCK_TRACE_PAGES);
+  if (header == NULL)
+    PANIC ("couldn't allocate buffer");
+
+  cnt = block_trace_read (entries, BLOCK_TRACE_MAX);
+  printf ("Dumping %zu traced block requests to scratch device...\n", cnt);
+  sectors = DIV_ROUND_UP (cnt * sizeof *entries, BLOCK_SECTOR_SIZE);
+  if (1 + sectors > block_size (dst))
+    PANIC ("out of space on scratch device");
+  header->magic = TRACE_MAGIC;
+  header->cnt = cnt;
+  block_write (dst, 0, header);
+  if (sectors > 0)
+    block_write_multiple (dst, 1, sectors, entries);
+
+  palloc_free_multiple (entries, BLOCK_TRACE_PAGES);
+  free (header);
+}
+
+/* A request in flight in fsutil_replay(). */
+struct replay_slot
+  {
+    struct block_request req;           /* The request. */
+    bool busy;                          /* In flight? */
+    uint8_t *buffer;                    /* REPLAY_PAGES pages. */
+  };
+
+/* Shared by fsutil_replay() and replay_done(). */
+static struct semaphore replay_free;    /* Up once per free slot. */
+static uint64_t replay_latency_sum;     /* Latencies in cycles. */
+static uint64_t replay_latency_max;
+
+/* Accounts for finished replay request R and frees its slot. */
+static void
+replay_done (struct block_request *r)
+{
+  struct replay_slot *slot = r->aux;
+  uint64_t latency = timer_cycles () - r->submitted;
+
+  replay_latency_sum += latency;
+  if (latency > replay_latency_max)
+    replay_latency_max = latency;
+  slot->busy = false;
+  sema_up (&replay_free);
+}
+
+/* Returns true if writing garbage to DST could damage a device
+   that Pintos uses or does not own: if DST is, contains, lies
+   under or is stacked on one of the kernel, file system, scratch
+   and swap devices or a foreign partition. */
+static bool
+replay_unsafe (struct block *dst)
+{
+  struct block *b;
+  enum block_type role;
+
+  for (role = 0; role < BLOCK_ROLE_CNT; role++)
+    {
+      b = block_get_role (role);
+      if (b != NULL
+          && (block_stacked_on (b, dst) || block_stacked_on (dst, b)))
+        return true;
+    }
+  for (b = block_first (); b != NULL; b = block_next (b))
+    if (block_type (b) == BLOCK_FOREIGN
+        && (block_stacked_on (b, dst) || block_stacked_on (dst, b)))
+      return true;
+  return false;
+}
+
+/* Reads the block I/O trace that fsutil_trace_dump() wrote to
+   the scratch device and issues its requests, in order and as
+   fast as REPLAY_DEPTH requests in flight allow, to block device
+   ARGV[1], in the traced classes.  Requests from every traced
+   device go to that one device, with their sectors wrapped to
+   fit in it and their size capped at REPLAY_MAX_SECTORS.  Writes
+   write garbage, so devices replay_unsafe() rejects are refused.
+   Reports throughput and latency. */
+void
+fsutil_replay (char **argv)
+{
+  const char *name = argv[1];
+  struct replay_slot slots[REPLAY_DEPTH];
+  struct trace_header *header;
+  struct block_trace_entry *entries;
+  struct block *src, *dst;
+  enum block_io_class old_class;
+  unsigned long long sectors = 0;
+  int64_t start;
+  long long ms;
+  size_t cnt, replayed = 0, i, j;
+
+  src = block_get_role (BLOCK_SCRATCH);
+  if (src == NULL)
+    PANIC ("couldn't open scratch device");
+  dst = block_get_by_name (name);
+  if (dst == NULL)
+    PANIC ("%s: no such block device", name);
+  if (replay_unsafe (dst))
+    PANIC ("%s: refusing to replay writes to this device", name);
+
+  /* Read the trace. */
+  header = malloc (sizeof *header);
+  entries = palloc_get_multiple (PAL_ASSERT, BLOCK_TRACE_PAGES);
+  if (header == NULL)
+    PANIC ("couldn't allocate buffer");
+  block_read (src, 0, header);
+  if (header->magic != TRACE_MAGIC || header->cnt > BLOCK_TRACE_MAX)
+    PANIC ("no block I/O trace on scratch device");
+  cnt = header->cnt;
+  if (cnt > 0)
+    block_read_multiple (src, 1,
+                         DIV_ROUND_UP (cnt * sizeof *entries,
+                                       BLOCK_SECTOR_SIZE), entries);
+  printf ("Replaying %zu block requests on %s...\n", cnt, name);
+
+  sema_init (&replay_free, REPLAY_DEPTH);
+  for (j = 0; j < REPLAY_DEPTH; j++)
+    {
+      slots[j].busy = false;
+      slots[j].buffer = palloc_get_multiple (PAL_ASSERT, REPLAY_PAGES);
+    }
+  replay_latency_sum = replay_latency_max = 0;
+
+  old_class = block_set_io_class (BLOCK_IO_DEMAND);
+  start = timer_ticks ();
+  for (i = 0; i < cnt; i++)
+    {
+      struct block_trace_entry *e = &entries[i];
+      struct block_request *r;
+      block_sector_t size = block_size (dst);
+      block_sector_t n = e->cnt;
+
+      if (n > REPLAY_MAX_SECTORS)
+        n = REPLAY_MAX_SECTORS;
+      if (n > size)
+        n = size;
+      if (n == 0 || e->io_class >= BLOCK_IO_CLASS_CNT)
+        continue;
+
+      sema_down (&replay_free);
+      for (j = 0; slots[j].busy; j++)
+        continue;
+      slots[j].busy = true;
+      r = &slots[j].req;
+      r->sector = e->sector % (size - n + 1);
+      r->cnt = n;
+      r->buffer = slots[j].buffer;
+      r->write = e->write;
+      r->done = replay_done;
+      r->aux = &slots[j];
+      block_set_io_class (e->io_class);
+      block_submit (dst, r);
+      replayed++;
+      sectors += n;
+    }
+  for (j = 0; j < REPLAY_DEPTH; j++)
+    sema_down (&replay_free);
+  ms = timer_elapsed (start) * 1000 / TIMER_FREQ;
+  block_set_io_class (old_class);
+
+  printf ("Replayed %zu requests, %llu sectors in %lld ms",
+          replayed, sectors, ms);
+  if (ms > 0)
+    printf (" (%lld kB/s)", sectors * BLOCK_SECTOR_SIZE * 1000 / 1024 / ms);
+  printf ("\n");
+  if (replayed > 0)
+    printf ("Latency: %llu us average, %llu us max\n",
+            timer_cycles_to_us (replay_latency_sum / replayed),
+            timer_cycles_to_us (replay_latency_max));
+
+  for (j = 0; j < REPLAY_DEPTH; j++)
+    palloc_free_multiple (slots[j].buffer, REPLAY_PAGES);
+  palloc_free_multiple (entries, BLOCK_TRACE_PAGES);
+  free (header);
+}
+
+/* Starts defragmenting the file system in the background.  It
+   runs alongside later actions and stops at shutdown. */
+void
+fsutil_defrag (char **argv UNUSED)
+{
+  printf ("Defragmenting file system in the background...\n");
+  defrag_start ();
+}
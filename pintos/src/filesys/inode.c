@@ -1,10 +1,14 @@
 #include "filesys/inode.h"
 #include <list.h>
 #include <debug.h>
+#include <limits.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/defrag.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/procfs.h"
+#include "filesys/tmpfs.h"
 #include "threads/malloc.h"
 #include "cache.h"
 #include "threads/thread.h"
@@ -16,6 +20,9 @@
 #define INODE_MAGIC 0x494e4f44
 #define NUM_DIRECT_BLOCKS 12
 #define BLOCKS_PER_INDIRECT (BLOCK_SECTOR_SIZE / 4)
+#define DOUBLY_INDIRECT_START (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
+#define MAX_SECTORS (DOUBLY_INDIRECT_START \
+                     + BLOCKS_PER_INDIRECT * BLOCKS_PER_INDIRECT)
 
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -26,6 +33,28 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* Returns true if inode number SECTOR is kept in memory by tmpfs,
+   either as a tmpfs file or as a rendered procfs file. */
+static inline bool
+in_memory (block_sector_t sector)
+{
+  return tmpfs_is_inumber (sector) || procfs_is_inumber (sector);
+}
+
+/* On-disk inode.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct inode_disk
+  {
+    off_t length;                       /* File size in bytes. */
+    uint32_t sector_cnt;                /* Data sectors allocated. */
+    block_sector_t direct_blocks[NUM_DIRECT_BLOCKS];
+    block_sector_t indirect_block;
+    block_sector_t doubly_indirect_block;
+    uint32_t is_dir;                    /* Nonzero for a directory. */
+    unsigned magic;                     /* Magic number. */
+    uint32_t unused[110];               /* Not used. */
+  };
+
 /* In-memory inode. */
 struct inode 
   {
@@ -34,17 +63,79 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
-    off_t length;
-    block_sector_t direct_blocks[NUM_DIRECT_BLOCKS];
-    block_sector_t indirect_block;
-    block_sector_t doubly_indirect_block;
-    bool is_dir;
-    struct lock extend_lock; // for file extension
+    struct inode_disk data;             /* Inode content. */
+    struct tmpfs_node *mem;             /* tmpfs storage, or null for disk. */
+    struct lock extend_lock; // protects length, max_read_length and write_ranges
     struct lock dir_lock;   // for directory locking
     off_t max_read_length; // limits the byte to be read, if the inode is being extended
-    unsigned magic;
+    off_t synced_length;   // length last written out by inode_sync
+    struct list write_ranges; // writes in progress past max_read_length
+    struct condition range_done; // signaled when a write range finishes
+    off_t free_slot;       // for directories: no free entry before this offset
+    bool moving;           // data being relocated by inode_defrag
+    bool move_aborted;     // an opener is waiting for the move to finish
+    struct lock io_lock;   // protects active_io and shrinking
+    int active_io;         // reads and writes using the data right now
+    bool shrinking;        // inode_truncate in progress
+    struct condition io_done; // signaled as I/O drains or shrinking ends
+  };
+
+/* A write in progress that reaches past max_read_length.
+   Readers may not see bytes at or after DONE until the writer
+   has copied them in. */
+struct write_range
+  {
+    struct list_elem elem;              /* Element in write_ranges. */
+    off_t start;                        /* First byte being written. */
+    off_t end;                          /* Byte after the last one. */
+    off_t done;                         /* Written up to here. */
+    bool active;                        /* In write_ranges? */
   };
 
+/* Returns true if writes to INODE are refused, because an opener
+   has denied them or because it is a read-only procfs file. */
+static inline bool
+writes_denied (const struct inode *inode)
+{
+  return inode->deny_write_cnt > 0 || procfs_is_inumber (inode->sector);
+}
+
+/* Returns entry I of index block TABLE. */
+static block_sector_t
+get_entry (block_sector_t table, int i)
+{
+  block_sector_t sector;
+  cache_read_at (table, &sector, i * sizeof sector, sizeof sector);
+  return sector;
+}
+
+/* Sets entry I of INODE's index block TABLE to SECTOR. */
+static void
+set_entry (struct inode *inode, block_sector_t table, int i,
+           block_sector_t sector)
+{
+  cache_write_at (table, &sector, i * sizeof sector, sizeof sector,
+                  inode->sector);
+}
+
+/* Returns the sector that holds data block IDX of INODE, which
+   must be less than its sector_cnt. */
+static block_sector_t
+lookup_block (const struct inode *inode, size_t idx)
+{
+  block_sector_t table;
+
+  ASSERT (idx < inode->data.sector_cnt);
+  if (idx < NUM_DIRECT_BLOCKS)
+    return inode->data.direct_blocks[idx];
+  if (idx < DOUBLY_INDIRECT_START)
+    return get_entry (inode->data.indirect_block, idx - NUM_DIRECT_BLOCKS);
+  idx -= DOUBLY_INDIRECT_START;
+  table = get_entry (inode->data.doubly_indirect_block,
+                     idx / BLOCKS_PER_INDIRECT);
+  return get_entry (table, idx % BLOCKS_PER_INDIRECT);
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -53,29 +144,8 @@ static block_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
-  block_sector_t block_buf[BLOCKS_PER_INDIRECT];
-  if (pos < inode->length)
-  {
-    int block_num = pos / BLOCK_SECTOR_SIZE;
-    if (block_num < NUM_DIRECT_BLOCKS)
-    {
-      return inode->direct_blocks[block_num];
-    }
-    if (block_num < NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
-    {
-      block_read (fs_device, inode->indirect_block, block_buf);
-      return block_buf[block_num - NUM_DIRECT_BLOCKS];
-    }
-    else
-    {
-      int indirect_block_num = ( block_num - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) / BLOCKS_PER_INDIRECT;
-      block_read (fs_device, inode->doubly_indirect_block, block_buf);
-      block_read (fs_device, block_buf[indirect_block_num], block_buf);
-      int final_block_index = ( block_num - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) % BLOCKS_PER_INDIRECT;
-      return block_buf[final_block_index];
-
-    }
-  }
+  if (pos < inode->data.length)
+    return lookup_block (inode, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
@@ -86,12 +156,27 @@ byte_to_sector (const struct inode *inode, off_t pos)
 struct lock inode_list_lock;
 static struct list open_inodes;
 
+/* Signaled, with inode_list_lock, when inode_defrag() finishes
+   with an inode. */
+static struct condition move_done;
+
+/* Reads and writes through the inode layer, for the defragmenter
+   to back off under.  Updated without a lock: it only needs to
+   change when there is foreground I/O. */
+static unsigned io_cnt;
+
+static bool extend_to (struct inode *inode, off_t length);
+static void write_inode (struct inode *inode);
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
+  ASSERT (sizeof (struct inode_disk) == BLOCK_SECTOR_SIZE);
+
   lock_init (&inode_list_lock);
   list_init (&open_inodes);
+  cond_init (&move_done);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -102,34 +187,34 @@ inode_init (void)
 bool
 inode_create (block_sector_t sector_, off_t length, bool is_dir)
 {
-  uint8_t buf[BLOCK_SECTOR_SIZE];
+  return inode_create_in (in_memory (sector_) ? tmpfs_lookup (sector_) : NULL,
+                          sector_, length, is_dir);
+}
+
+/* Like inode_create(), but keeps the inode in tmpfs node MEM,
+   which need not be one that tmpfs_lookup() finds, if SECTOR_ is
+   kept in memory. */
+bool
+inode_create_in (struct tmpfs_node *mem, block_sector_t sector_,
+                 off_t length, bool is_dir)
+{
   bool success = false;
 
   ASSERT (length >= 0);
-  struct inode *inode = malloc (sizeof (struct inode));
+  struct inode *inode = calloc (1, sizeof (struct inode));
   if (inode != NULL)
   {
     inode->sector = sector_;
-    inode->length = 0;
-    inode->magic = INODE_MAGIC;
-    inode->open_cnt = 0;
-    inode->removed = 0;
-    inode->deny_write_cnt = 0;
-    inode->indirect_block = 0;
-    inode->doubly_indirect_block = 0;
-    inode->is_dir = is_dir;
-    memset (inode->direct_blocks, 0, sizeof inode->direct_blocks);
-
-    success = inode_extend (inode, bytes_to_sectors(length));
+    inode->data.magic = INODE_MAGIC;
+    inode->data.is_dir = is_dir;
+    if (in_memory (sector_))
+      inode->mem = mem;
+
+    success = (inode->mem != NULL || !in_memory (sector_))
+              && extend_to (inode, length);
 
     if (success)
-    {
-      inode->length = length;
-      inode->max_read_length = inode->length;
-      memset (buf, 0, BLOCK_SECTOR_SIZE);
-      memcpy (buf, inode, sizeof (*inode));
-      block_write (fs_device, inode->sector, buf);
-    }
+      write_inode (inode);
 
     free (inode);
   }
@@ -137,95 +222,95 @@ inode_create (block_sector_t sector_, off_t length, bool is_dir)
 }
 
 
-void inode_release_allocated_sectors (struct inode *inode, int num_blocks_to_remove)
+/* Frees SECTOR, which no longer belongs to any inode. */
+static void
+release_sector (block_sector_t sector)
 {
-  int indirect_block_num;
-  int final_block_index;
-  block_sector_t ind_block_buf[BLOCKS_PER_INDIRECT];
-  block_sector_t db_ind_block_buf[BLOCKS_PER_INDIRECT];
+  cache_discard (sector);
+  free_map_release (sector, 1);
+}
 
+/* Releases the last NUM_BLOCKS_TO_REMOVE data sectors of INODE,
+   along with any index blocks no longer needed.  Entries in the
+   remaining index blocks are cleared, since install_block relies
+   on them being zero. */
+void
+inode_release_allocated_sectors (struct inode *inode, int num_blocks_to_remove)
+{
+  size_t old_cnt = inode->data.sector_cnt;
+  size_t new_cnt;
+  size_t idx;
 
-  int block_num;
-  int original_inode_sectors = bytes_to_sectors (inode->length);
-  int new_sectors = original_inode_sectors - num_blocks_to_remove;
+  ASSERT (num_blocks_to_remove >= 0 && (size_t) num_blocks_to_remove <= old_cnt);
+  new_cnt = old_cnt - num_blocks_to_remove;
 
-  //initialize block buffers based on current number of sectors
-  if (inode->doubly_indirect_block != 0)
-  {
-    block_read (fs_device, inode->doubly_indirect_block, db_ind_block_buf);
-    indirect_block_num = ( original_inode_sectors - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) / BLOCKS_PER_INDIRECT;
-    block_read (fs_device, db_ind_block_buf[indirect_block_num], ind_block_buf);
-  }
-  else 
+  if (inode->mem != NULL)
   {
-    memset (db_ind_block_buf, 0, sizeof db_ind_block_buf);
-    
-    if (inode->indirect_block != 0)
-      block_read (fs_device, inode->indirect_block, ind_block_buf);
-    else
-      memset (ind_block_buf, 0, sizeof ind_block_buf);
+    tmpfs_resize (inode->mem, new_cnt);
+    inode->data.sector_cnt = new_cnt;
+    return;
   }
 
+  for (idx = new_cnt; idx < old_cnt; idx++)
+    release_sector (lookup_block (inode, idx));
 
-
-  for (block_num = original_inode_sectors - 1 ; block_num >= new_sectors; block_num --)
+  if (inode->data.doubly_indirect_block != 0)
   {
-    if (block_num >= NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
-    {
-      indirect_block_num = ( block_num - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) / BLOCKS_PER_INDIRECT;
-      final_block_index = ( block_num - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) % BLOCKS_PER_INDIRECT;
+    block_sector_t dbl = inode->data.doubly_indirect_block;
+    size_t keep = 0;
+    size_t t;
 
-      if ((final_block_index == BLOCK_SECTOR_SIZE - 1) 
-          && (indirect_block_num != BLOCK_SECTOR_SIZE -1)
-          && (db_ind_block_buf[indirect_block_num + 1] != 0))
-        // free previous indirect block, read in current indirect block
-      {
-        block_read (fs_device, db_ind_block_buf[indirect_block_num], ind_block_buf);
-        free_map_release (db_ind_block_buf[indirect_block_num + 1], 1);
-        db_ind_block_buf[indirect_block_num + 1] = 0;
-      }
-      free_map_release (ind_block_buf[final_block_index], 1);
-      continue;
-       
-    }
-    if ((block_num < NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
-      && (block_num >= NUM_DIRECT_BLOCKS))
-      //single indirect block now
+    if (new_cnt > DOUBLY_INDIRECT_START)
+      keep = DIV_ROUND_UP (new_cnt - DOUBLY_INDIRECT_START, BLOCKS_PER_INDIRECT);
+    for (t = keep; t < BLOCKS_PER_INDIRECT; t++)
     {
-      final_block_index = block_num - NUM_DIRECT_BLOCKS;
-      if ((final_block_index == BLOCK_SECTOR_SIZE -1)
-        && (inode->doubly_indirect_block != 0))
-      {
-        free_map_release (db_ind_block_buf[0], 1);
-        free_map_release (inode->doubly_indirect_block, 1);
-        inode->doubly_indirect_block = 0;
-        block_read (fs_device, inode->indirect_block, ind_block_buf);
-      }
-      free_map_release (ind_block_buf[final_block_index], 1);
-      continue;
+      block_sector_t table = get_entry (dbl, t);
+      if (table == 0)
+        break;
+      release_sector (table);
+      set_entry (inode, dbl, t, 0);
     }
-    if (block_num < NUM_DIRECT_BLOCKS)
-      //onto direct blocks now
+    if (keep == 0)
     {
-      if ((block_num == NUM_DIRECT_BLOCKS -1)
-        && (inode->indirect_block != 0))
-        {
-          free_map_release (inode->indirect_block, 1);
-          inode->indirect_block = 0;
-        }
-      free_map_release (inode->direct_blocks[block_num], 1);
-      continue;
+      release_sector (dbl);
+      inode->data.doubly_indirect_block = 0;
     }
   }
+  if (new_cnt <= NUM_DIRECT_BLOCKS && inode->data.indirect_block != 0)
+  {
+    release_sector (inode->data.indirect_block);
+    inode->data.indirect_block = 0;
+  }
+  inode->data.sector_cnt = new_cnt;
+}
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+   if it is not open.  If inode_defrag() is moving it, asks it to
+   stop and waits.  Must be called with inode_list_lock held. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
+  struct list_elem *e;
 
-  //rewrite doubly indirect block to disk
-  // this is necessary because inode_extend relies on 
-  // entries being null
-  if (inode->doubly_indirect_block != 0)
+  ASSERT (lock_held_by_current_thread (&inode_list_lock));
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e))
   {
-    block_write (fs_device, inode->doubly_indirect_block, db_ind_block_buf);
+    struct inode *inode = list_entry (e, struct inode, elem);
+    if (inode->sector == sector)
+    {
+      /* Reopen first, so that the mover's close cannot free it. */
+      inode_reopen (inode);
+      if (inode->moving)
+      {
+        inode->move_aborted = true;
+        while (inode->moving)
+          cond_wait (&move_done, &inode_list_lock);
+      }
+      return inode;
+    }
   }
+  return NULL;
 }
 
 /* Reads an inode from SECTOR
@@ -235,64 +320,88 @@ struct inode *
 inode_open (block_sector_t sector)
 {
 
-  struct list_elem *e;
   struct inode *inode;
-  uint8_t buf[BLOCK_SECTOR_SIZE];
+  struct tmpfs_node *snapshot = NULL;
 
   /* Check whether this inode is already open. */
   lock_acquire (&inode_list_lock);
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  inode = find_open_inode (sector);
+  lock_release (&inode_list_lock);
+  if (inode != NULL)
+    return inode;
+
+  /* A procfs file is rendered afresh for its first opener, into
+     a node of its own that only this inode refers to. */
+  if (procfs_is_inumber (sector))
   {
-    inode = list_entry (e, struct inode, elem);
-    if (inode->sector == sector) 
-      {
-        inode_reopen (inode);
-        lock_release (&inode_list_lock);
-        return inode; 
-      }
+    snapshot = procfs_render (sector);
+    if (snapshot == NULL)
+      return NULL;
   }
-  lock_release (&inode_list_lock);
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
+  {
+    tmpfs_free (snapshot);
     return NULL;
+  }
 
   /* Initialize. */
-  block_read (fs_device, sector, buf);
-  memcpy (inode, buf, sizeof (*inode));
+  inode->mem = NULL;
+  if (in_memory (sector))
+  {
+    inode->mem = snapshot != NULL ? snapshot : tmpfs_lookup (sector);
+    if (inode->mem == NULL)
+    {
+      free (inode);
+      return NULL;
+    }
+    memcpy (&inode->data, tmpfs_inode (inode->mem), BLOCK_SECTOR_SIZE);
+  }
+  else
+    cache_read (sector, &inode->data);
+  inode->sector = sector;
 
-  if ( (inode->sector != sector)
-        || (inode->magic) != INODE_MAGIC)
+  if (inode->data.magic != INODE_MAGIC)
   {
+    tmpfs_free (snapshot);
     free (inode);
     return NULL;
   }
 
+  /* Finish initializing before publishing the inode: another
+     opener may find it in the list as soon as it is there. */
+  inode->open_cnt = 1;
+  inode->removed = false;
+  inode->deny_write_cnt = 0;
+  inode->max_read_length = inode->data.length;
+  inode->synced_length = inode->data.length;
+  inode->free_slot = 0;
+  inode->moving = false;
+  inode->move_aborted = false;
+  lock_init (&inode->extend_lock);
+  lock_init (&inode->dir_lock);
+  list_init (&inode->write_ranges);
+  cond_init (&inode->range_done);
+  lock_init (&inode->io_lock);
+  inode->active_io = 0;
+  inode->shrinking = false;
+  cond_init (&inode->io_done);
+
   lock_acquire (&inode_list_lock);
   //double check the inode hasn't been added by someone else
-  struct inode *other_inode;
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  struct inode *other_inode = find_open_inode (sector);
+  if (other_inode != NULL)
   {
-    other_inode = list_entry (e, struct inode, elem);
-    if (other_inode->sector == sector) 
-      {
-        inode_reopen (other_inode);
-        free (inode);
-        lock_release (&inode_list_lock);
-        return other_inode; 
-      }
+    tmpfs_free (snapshot);
+    free (inode);
+    lock_release (&inode_list_lock);
+    return other_inode;
   }
   // it hasn't been added by someone else. push onto list.
   list_push_front (&open_inodes, &inode->elem);
   lock_release (&inode_list_lock);
-
-  inode->open_cnt = 1;
-  inode->deny_write_cnt = 0;
-  lock_init (&inode->extend_lock);
-  lock_init (&inode->dir_lock);
   return inode;
 }
 
@@ -322,25 +431,36 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  The count
+     drops and the inode leaves the list under inode_list_lock,
+     so that find_open_inode() never reopens a closing inode. */
+  lock_acquire (&inode_list_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
+      lock_release (&inode_list_lock);
+      return;
+    }
+  list_remove (&inode->elem);
+
+  /* A procfs snapshot goes too, to be rendered again by the
+     next opener. */
+  if (procfs_is_inumber (inode->sector))
+    tmpfs_free (inode->mem);
+  lock_release (&inode_list_lock);
+
+  /* Deallocate blocks if removed. */
+  if (inode->removed && !procfs_is_inumber (inode->sector))
+    {
+      if (inode->mem != NULL)
+        tmpfs_free (inode->mem);
+      else
         {
-          int num_sectors = bytes_to_sectors (inode->length);
-          inode_release_allocated_sectors (inode, num_sectors); 
-          uint8_t buf[BLOCK_SECTOR_SIZE];
-          memset (buf, 0, BLOCK_SECTOR_SIZE);
-          block_write (fs_device, inode->sector, buf);
-          free_map_release (inode->sector, 1);
+          inode_release_allocated_sectors (inode, inode->data.sector_cnt); 
+          release_sector (inode->sector);
         }
-
-      free (inode); 
     }
+
+  free (inode); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -352,6 +472,29 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Marks the start of a read or write of INODE's data, first
+   waiting out any inode_truncate() in progress, so that the
+   sectors or pages looked up stay INODE's until io_end(). */
+static void
+io_begin (struct inode *inode)
+{
+  lock_acquire (&inode->io_lock);
+  while (inode->shrinking)
+    cond_wait (&inode->io_done, &inode->io_lock);
+  inode->active_io++;
+  lock_release (&inode->io_lock);
+}
+
+/* Marks the end of a read or write begun with io_begin(). */
+static void
+io_end (struct inode *inode)
+{
+  lock_acquire (&inode->io_lock);
+  if (--inode->active_io == 0)
+    cond_broadcast (&inode->io_done, &inode->io_lock);
+  lock_release (&inode->io_lock);
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -361,12 +504,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
   struct cached_block *cached_block;
-  block_sector_t sector_idx = -1;
+  block_sector_t sector_idx;
 
+  io_cnt++;
+  io_begin (inode);
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -379,7 +523,18 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
+      if (inode->mem != NULL)
+      {
+        memcpy (buffer + bytes_read, tmpfs_block (inode->mem,
+                offset / BLOCK_SECTOR_SIZE) + sector_ofs, chunk_size);
+        size -= chunk_size;
+        offset += chunk_size;
+        bytes_read += chunk_size;
+        continue;
+      }
 
+      /* Disk sector to read. */
+      sector_idx = byte_to_sector (inode, offset);
       cached_block = cache_insert (sector_idx);
 
 
@@ -408,63 +563,171 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
 
     }
-    if (((int)sector_idx != -1) && (bytes_to_sectors (inode->max_read_length) > sector_idx))
+    if (bytes_read > 0 && inode->mem == NULL
+        && offset + BLOCK_SECTOR_SIZE < inode->max_read_length)
     {
       block_sector_t next_sector = byte_to_sector (inode, offset + BLOCK_SECTOR_SIZE);
       cache_read_ahead (next_sector);
     }
-
+  io_end (inode);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs. */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+/* Grows INODE to LENGTH bytes, allocating sectors as needed,
+   and zeroes the sectors it grows over in the cache: they are
+   either new or reserved by inode_allocate() and unwritten.
+   The caller must hold INODE's extend_lock and is responsible
+   for publishing max_read_length.
+   Returns false if the disk is full. */
+static bool
+extend_to (struct inode *inode, off_t length)
 {
-  const uint8_t *buffer = buffer_;
-  off_t bytes_written = 0;
-  struct cached_block *cached_block;
-  block_sector_t sector_idx = -1;
-  bool extending = false;
+  size_t new_sectors = bytes_to_sectors (length);
+  size_t idx;
+
+  ASSERT (length >= inode->data.length);
+  if (new_sectors > inode->data.sector_cnt
+      && !inode_extend (inode, new_sectors - inode->data.sector_cnt))
+    return false;
+  for (idx = bytes_to_sectors (inode->data.length); idx < new_sectors; idx++)
+    if (inode->mem != NULL)
+      memset (tmpfs_block (inode->mem, idx), 0, BLOCK_SECTOR_SIZE);
+    else
+      cache_zero (lookup_block (inode, idx), inode->sector);
+  inode->data.length = length;
+  return true;
+}
 
-  if (inode->deny_write_cnt)
-    return 0;
+/* Writes INODE's on-disk part into the buffer cache, where it
+   stays dirty until the write-behind thread or a flush writes it
+   back.  A tmpfs inode keeps it in its node instead. */
+static void
+write_inode (struct inode *inode)
+{
+  if (inode->mem != NULL)
+    memcpy (tmpfs_inode (inode->mem), &inode->data, BLOCK_SECTOR_SIZE);
+  else
+    cache_write (inode->sector, &inode->data, inode->sector);
+}
 
-  //grow inode if necessary
-  
-  if (offset + size > inode->max_read_length)
+/* Advances max_read_length as far as every write range allows:
+   up to the length, but not past the unwritten part of any range
+   in progress.  It never moves backward.  The caller must hold
+   INODE's extend_lock. */
+static void
+publish_length (struct inode *inode)
+{
+  off_t readable = inode->data.length;
+  struct list_elem *e;
+
+  for (e = list_begin (&inode->write_ranges);
+       e != list_end (&inode->write_ranges); e = list_next (e))
   {
+    struct write_range *r = list_entry (e, struct write_range, elem);
+    if (r->done < readable)
+      readable = r->done;
+  }
+  if (readable > inode->max_read_length)
+    inode->max_read_length = readable;
+}
 
-    extending = true;
-    lock_acquire (&inode->extend_lock);
-    if (offset + size > inode->max_read_length)
+/* Prepares to write bytes START through END - 1 of INODE.
+   A write that stays below max_read_length needs nothing.
+   Otherwise waits for overlapping writes past max_read_length to
+   finish, grows the inode if needed, and registers R so that
+   readers only see the new bytes as they are written.  Only this
+   metadata update happens under extend_lock; the data copy does
+   not, so appenders and other non-overlapping writers proceed in
+   parallel.  Returns false if the disk is full. */
+static bool
+range_begin (struct inode *inode, struct write_range *r,
+             off_t start, off_t end)
+{
+  r->start = r->done = start;
+  r->end = end;
+  r->active = false;
+  if (end <= inode->max_read_length)
+    return true;
+
+  lock_acquire (&inode->extend_lock);
+  for (;;)
+  {
+    struct list_elem *e;
+    bool overlap = false;
+
+    for (e = list_begin (&inode->write_ranges);
+         e != list_end (&inode->write_ranges); e = list_next (e))
     {
-      int num_blocks_to_add = bytes_to_sectors (offset + size ) - bytes_to_sectors (inode_length (inode));
-      if (num_blocks_to_add > 0)
+      struct write_range *other = list_entry (e, struct write_range, elem);
+      if (start < other->end && other->start < end)
       {
-        if (!inode_extend(inode, num_blocks_to_add))
-        {
-          lock_release (&inode->extend_lock);
-          return 0;
-        }
+        overlap = true;
+        break;
       }
-      inode->length = offset + size ;
     }
-    else
+    if (!overlap)
+      break;
+    cond_wait (&inode->range_done, &inode->extend_lock);
+  }
+
+  if (end > inode->max_read_length)
+  {
+    if (end > inode->data.length)
     {
-      extending = false;
-      lock_release (&inode->extend_lock);
+      if (!extend_to (inode, end))
+      {
+        lock_release (&inode->extend_lock);
+        return false;
+      }
+      write_inode (inode);
     }
+    list_push_back (&inode->write_ranges, &r->elem);
+    r->active = true;
   }
+  lock_release (&inode->extend_lock);
+  return true;
+}
+
+/* Records that R has been written up to DONE and publishes the
+   new bytes to readers. */
+static void
+range_advance (struct inode *inode, struct write_range *r, off_t done)
+{
+  if (!r->active)
+    return;
+  lock_acquire (&inode->extend_lock);
+  r->done = done;
+  publish_length (inode);
+  lock_release (&inode->extend_lock);
+}
+
+/* Finishes R, begun with range_begin(). */
+static void
+range_end (struct inode *inode, struct write_range *r)
+{
+  if (!r->active)
+    return;
+  lock_acquire (&inode->extend_lock);
+  list_remove (&r->elem);
+  publish_length (inode);
+  cond_broadcast (&inode->range_done, &inode->extend_lock);
+  lock_release (&inode->extend_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into INODE at OFFSET, which the
+   caller has already made room for with range_begin() on R.
+   Returns the number of bytes actually written. */
+static off_t
+write_sectors (struct inode *inode, const uint8_t *buffer, off_t size,
+               off_t offset, struct write_range *r)
+{
+  off_t bytes_written = 0;
+  struct cached_block *cached_block;
 
   while (size > 0) 
   {
-    /* Sector to write, starting byte offset within sector. */
-    sector_idx = byte_to_sector (inode, offset);
+    /* Starting byte offset within sector. */
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -477,6 +740,19 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     if (chunk_size <= 0)
       break;
 
+    if (inode->mem != NULL)
+    {
+      memcpy (tmpfs_block (inode->mem, offset / BLOCK_SECTOR_SIZE)
+              + sector_ofs, buffer + bytes_written, chunk_size);
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+      range_advance (inode, r, offset);
+      continue;
+    }
+
+    /* Sector to write. */
+    block_sector_t sector_idx = byte_to_sector (inode, offset);
     cached_block = cache_insert (sector_idx);
 
     cached_block->active_r_w ++ ;
@@ -486,6 +762,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     thread_current ()->cache_block_being_accessed = cached_block;
     memcpy (cached_block->data + sector_ofs, buffer + bytes_written, chunk_size);
     cached_block->dirty = true;
+    cached_block->owner = inode->sector;
 
     thread_current ()->cache_block_being_accessed = NULL;
 
@@ -500,26 +777,258 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     size -= chunk_size;
     offset += chunk_size;
     bytes_written += chunk_size;
+    range_advance (inode, r, offset);
+  }
+
+  return bytes_written;
+}
 
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if end of file is reached or an error occurs. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
+                off_t offset) 
+{
+  struct write_range range;
+  off_t bytes_written;
+
+  if (writes_denied (inode) || size <= 0)
+    return 0;
+  io_cnt++;
+
+  io_begin (inode);
+  //grow inode if necessary
+  if (!range_begin (inode, &range, offset, offset + size))
+  {
+    io_end (inode);
+    return 0;
   }
+  bytes_written = write_sectors (inode, buffer, size, offset, &range);
+  range_end (inode, &range);
+
+  offset += bytes_written;
+  if (bytes_written > 0 && inode->mem == NULL
+      && offset + BLOCK_SECTOR_SIZE < inode->max_read_length)
+    cache_read_ahead (byte_to_sector (inode, offset + BLOCK_SECTOR_SIZE));
+  io_end (inode);
+
+  return bytes_written;
+}
+
+/* Does the work of inode_copy_at(), which has already guarded
+   both inodes with io_begin(). */
+static off_t
+copy_range (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size)
+{
+  off_t bytes_copied = 0;
+  struct cached_block *cached_block;
+  struct write_range range;
+
+  /* Clamp without computing SRC_OFS + SIZE, which may overflow. */
+  if (src_ofs >= src->max_read_length)
+    return 0;
+  if (size > src->max_read_length - src_ofs)
+    size = src->max_read_length - src_ofs;
+  if (size <= 0 || size > INT_MAX - dst_ofs || writes_denied (dst))
+    return 0;
+  io_cnt++;
+  if (src == dst && src_ofs < dst_ofs + size && dst_ofs < src_ofs + size)
+    return -1;
+
+  /* Grow DST once up front rather than one sector per chunk. */
+  if (!range_begin (dst, &range, dst_ofs, dst_ofs + size))
+    return 0;
 
-  if (((int)sector_idx != -1) && (bytes_to_sectors (inode->max_read_length) > sector_idx))
+  while (size > 0)
   {
-    block_sector_t next_sector = byte_to_sector (inode, offset + BLOCK_SECTOR_SIZE);
-    cache_read_ahead (next_sector);
+    int sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+    int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+    int chunk_size = size < sector_left ? size : sector_left;
+    off_t bytes_written;
+
+    if (src->mem != NULL)
+    {
+      bytes_written = write_sectors (dst, tmpfs_block (src->mem,
+                                     src_ofs / BLOCK_SECTOR_SIZE) + sector_ofs,
+                                     chunk_size, dst_ofs, &range);
+      size -= bytes_written;
+      src_ofs += bytes_written;
+      dst_ofs += bytes_written;
+      bytes_copied += bytes_written;
+      if (bytes_written < chunk_size)
+        break;
+      continue;
+    }
+
+    block_sector_t sector_idx = byte_to_sector (src, src_ofs);
+    if (src_ofs + BLOCK_SECTOR_SIZE < src->max_read_length)
+      cache_read_ahead (byte_to_sector (src, src_ofs + BLOCK_SECTOR_SIZE));
+
+    /* Hold the source block in place.  cache_run_clock() will
+       not evict it while active_r_w is nonzero, so the
+       destination's cache_insert() cannot deadlock on it. */
+    cached_block = cache_insert (sector_idx);
+    cached_block->active_r_w ++ ;
+    lock_release (&cached_block->lock);
+
+    bytes_written = write_sectors (dst, cached_block->data + sector_ofs,
+                                   chunk_size, dst_ofs, &range);
+    cached_block->accessed = true;
+
+    lock_acquire (&cached_block->lock);
+    cached_block->active_r_w --;
+    if (cached_block->active_r_w == 0)
+      cond_broadcast (&cached_block->r_w_done, &cached_block->lock);
+    lock_release (&cached_block->lock);
+
+    size -= bytes_written;
+    src_ofs += bytes_written;
+    dst_ofs += bytes_written;
+    bytes_copied += bytes_written;
+    if (bytes_written < chunk_size)
+      break;
   }
+  range_end (dst, &range);
+
+  return bytes_copied;
+}
 
-  if (extending)
+/* Copies SIZE bytes from SRC, starting at SRC_OFS, into DST,
+   starting at DST_OFS, without a bounce buffer: each source
+   sector is held in the cache while write_sectors() copies
+   straight out of it, so a copy costs one memcpy per sector.
+   Returns the number of bytes actually copied, which may be less
+   than SIZE if end of SRC is reached or an error occurs, or -1
+   if the two ranges overlap within the same inode. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+               off_t src_ofs, off_t size)
+{
+  struct inode *first = src < dst ? src : dst;
+  struct inode *second = src < dst ? dst : src;
+  off_t bytes_copied;
+
+  /* Always guard in the same order, so that copies in opposite
+     directions cannot deadlock against truncations of both. */
+  io_begin (first);
+  if (second != first)
+    io_begin (second);
+  bytes_copied = copy_range (dst, dst_ofs, src, src_ofs, size);
+  if (second != first)
+    io_end (second);
+  io_end (first);
+  return bytes_copied;
+}
+
+/* Writes INODE's dirty data and index blocks from the cache to
+   disk.  Also writes the inode itself and the free map, unless
+   DATA_ONLY is true and the length has not changed since the last
+   sync, in which case the data can be read back without them.
+   A tmpfs inode has nothing to write. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  off_t length;
+
+  if (inode->mem != NULL)
+    return;
+  cache_flush_owner (inode->sector);
+
+  lock_acquire (&inode->extend_lock);
+  length = inode->data.length;
+  lock_release (&inode->extend_lock);
+  if (data_only && length == inode->synced_length)
+    return;
+
+  cache_flush_sector (inode->sector);
+  cache_flush_owner (FREE_MAP_SECTOR);
+  cache_flush_sector (FREE_MAP_SECTOR);
+  inode->synced_length = length;
+}
+
+/* Reserves disk space for the first LENGTH bytes of INODE
+   without writing it or changing INODE's length, so that later
+   writes up to LENGTH need no allocation.  The sectors are taken
+   in one contiguous run when possible.
+   Returns false if the disk is full or writes are denied. */
+bool
+inode_allocate (struct inode *inode, off_t length)
+{
+  size_t sectors = bytes_to_sectors (length);
+  bool success = true;
+
+  if (writes_denied (inode))
+    return false;
+
+  lock_acquire (&inode->extend_lock);
+  if (sectors > inode->data.sector_cnt)
   {
-    inode->max_read_length = inode->length;
-    uint8_t buf[BLOCK_SECTOR_SIZE];
-    memset (buf, 0, BLOCK_SECTOR_SIZE);
-    memcpy (buf, inode, sizeof (*inode));
-    block_write (fs_device, inode->sector, buf);
-    lock_release (&inode->extend_lock);
+    success = inode_extend (inode, sectors - inode->data.sector_cnt);
+    if (success)
+      write_inode (inode);
   }
+  lock_release (&inode->extend_lock);
+  return success;
+}
 
-  return bytes_written;
+/* Sets INODE's length to LENGTH.  Growing zero-fills like a
+   write past the end would; shrinking releases every sector past
+   the new end, including ones reserved by inode_allocate(), and
+   zeroes the rest of the new last sector so that growing again
+   reads back zeros.  Waits for reads and writes in progress
+   and holds off new ones until done, so none of them uses a
+   released sector.
+   Returns false if the disk is full or writes are denied. */
+bool
+inode_truncate (struct inode *inode, off_t length)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  bool success = true;
+
+  if (writes_denied (inode))
+    return false;
+
+  /* Keep reads and writes out while sectors may be released.
+     This comes before extend_lock, which they may hold waiting. */
+  lock_acquire (&inode->io_lock);
+  while (inode->shrinking)
+    cond_wait (&inode->io_done, &inode->io_lock);
+  inode->shrinking = true;
+  while (inode->active_io > 0)
+    cond_wait (&inode->io_done, &inode->io_lock);
+  lock_release (&inode->io_lock);
+
+  lock_acquire (&inode->extend_lock);
+  while (!list_empty (&inode->write_ranges))
+    cond_wait (&inode->range_done, &inode->extend_lock);
+
+  if (length >= inode->data.length)
+    success = extend_to (inode, length);
+  else
+  {
+    size_t sectors = bytes_to_sectors (length);
+    int tail_ofs = length % BLOCK_SECTOR_SIZE;
+
+    if (tail_ofs != 0 && inode->mem != NULL)
+      memcpy (tmpfs_block (inode->mem, sectors - 1) + tail_ofs, zeros,
+              BLOCK_SECTOR_SIZE - tail_ofs);
+    else if (tail_ofs != 0)
+      cache_write_at (lookup_block (inode, sectors - 1), zeros, tail_ofs,
+                      BLOCK_SECTOR_SIZE - tail_ofs, inode->sector);
+    inode_release_allocated_sectors (inode, inode->data.sector_cnt - sectors);
+    inode->data.length = length;
+  }
+  inode->max_read_length = inode->data.length;
+  write_inode (inode);
+  lock_release (&inode->extend_lock);
+
+  lock_acquire (&inode->io_lock);
+  inode->shrinking = false;
+  cond_broadcast (&inode->io_done, &inode->io_lock);
+  lock_release (&inode->io_lock);
+  return success;
 }
 
 /* Disables writes to INODE.
@@ -546,155 +1055,238 @@ inode_allow_write (struct inode *inode)
 off_t
 inode_length (const struct inode *inode)
 {
-  return inode->length;
+  return inode->data.length;
 }
 
-bool 
-inode_extend (struct inode *inode, int num_blocks_to_add)
+/* Makes sure *SLOT, in INODE's on-disk inode, names an index
+   block, allocating a zeroed one if it does not.
+   Returns false if the disk is full. */
+static bool
+get_index_slot (struct inode *inode, block_sector_t *slot)
 {
-  ASSERT (num_blocks_to_add >= 0);
-
-  block_sector_t ind_block_buf[BLOCKS_PER_INDIRECT];
-  block_sector_t db_ind_block_buf[BLOCKS_PER_INDIRECT];
-  static char zeros[BLOCK_SECTOR_SIZE];
-  bool success = true;
-
-  int indirect_block_num = 0;
-  int final_block_index = 0;
+  if (*slot == 0)
+  {
+    if (!free_map_allocate (1, slot))
+      return false;
+    cache_zero (*slot, inode->sector);
+  }
+  return true;
+}
 
-  size_t original_inode_sectors = bytes_to_sectors (inode_length (inode));
-  size_t new_sectors = original_inode_sectors + num_blocks_to_add;
+/* Returns the index block named by entry I of index block TABLE,
+   allocating a zeroed one if the entry is empty.
+   Returns 0 if the disk is full. */
+static block_sector_t
+get_index_entry (struct inode *inode, block_sector_t table, int i)
+{
+  block_sector_t sector = get_entry (table, i);
+  if (sector == 0)
+  {
+    if (!free_map_allocate (1, &sector))
+      return 0;
+    cache_zero (sector, inode->sector);
+    set_entry (inode, table, i, sector);
+  }
+  return sector;
+}
 
+/* Records SECTOR as data block IDX of INODE, allocating index
+   blocks on the way.  Returns false if the disk is full. */
+static bool
+install_block (struct inode *inode, size_t idx, block_sector_t sector)
+{
+  block_sector_t table;
 
-  //initialize block buffers based on current number of sectors
-  if (inode->doubly_indirect_block != 0)
+  if (idx < NUM_DIRECT_BLOCKS)
   {
-    block_read (fs_device, inode->doubly_indirect_block, db_ind_block_buf);
-    indirect_block_num = ( original_inode_sectors - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) / BLOCKS_PER_INDIRECT;
-    block_read (fs_device, db_ind_block_buf[indirect_block_num], ind_block_buf);
+    inode->data.direct_blocks[idx] = sector;
+    return true;
   }
-  else 
+  if (idx < DOUBLY_INDIRECT_START)
   {
-    memset (db_ind_block_buf, 0, sizeof db_ind_block_buf);
-    
-    if (inode->indirect_block != 0)
-      block_read (fs_device, inode->indirect_block, ind_block_buf);
-    else
-      memset (ind_block_buf, 0, sizeof ind_block_buf);
+    if (!get_index_slot (inode, &inode->data.indirect_block))
+      return false;
+    set_entry (inode, inode->data.indirect_block, idx - NUM_DIRECT_BLOCKS,
+               sector);
+    return true;
   }
+  idx -= DOUBLY_INDIRECT_START;
+  if (!get_index_slot (inode, &inode->data.doubly_indirect_block))
+    return false;
+  table = get_index_entry (inode, inode->data.doubly_indirect_block,
+                           idx / BLOCKS_PER_INDIRECT);
+  if (table == 0)
+    return false;
+  set_entry (inode, table, idx % BLOCKS_PER_INDIRECT, sector);
+  return true;
+}
 
+/* Allocates NUM_BLOCKS_TO_ADD more data sectors for INODE after
+   its last allocated one, in a single contiguous run if the free
+   map has one.  The new sectors are not written: they stay
+   unwritten until extend_to() zeroes them as the file grows over
+   them.  Rolls back and returns false if the disk is full. */
+bool 
+inode_extend (struct inode *inode, int num_blocks_to_add)
+{
+  size_t old_cnt = inode->data.sector_cnt;
+  size_t new_cnt = old_cnt + num_blocks_to_add;
+  block_sector_t start = 0;
+  bool contiguous;
+  size_t idx;
 
+  ASSERT (num_blocks_to_add >= 0);
+  if (new_cnt > MAX_SECTORS)
+    return false;
 
-  size_t block_num;
-  block_sector_t sector;
-  for (block_num = original_inode_sectors; block_num < new_sectors; block_num ++)
+  if (inode->mem != NULL)
   {
-    if (free_map_allocate (1, &sector))
+    if (!tmpfs_resize (inode->mem, new_cnt))
     {
-        if (block_num < NUM_DIRECT_BLOCKS)
-        {
-          inode->direct_blocks[block_num] = sector;
-          block_write (fs_device, sector, zeros);
-          continue;
-        }
-        if (block_num == NUM_DIRECT_BLOCKS && inode->indirect_block == 0)
-          //allocate indirect block
-        {
-          inode->indirect_block = sector;
-          block_write (fs_device, sector, zeros);
-          block_num --;
-          continue;
-        }
-        if (block_num < NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
-        {
-
-          ind_block_buf[block_num - NUM_DIRECT_BLOCKS] = sector;
-          block_write (fs_device, sector, zeros);
-
-          if ((block_num == new_sectors - 1) || (block_num == NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT - 1)) 
-          //last block or end of indirect block
-          {
-            block_write (fs_device, inode->indirect_block, ind_block_buf);
-            memset (ind_block_buf, 0, BLOCK_SECTOR_SIZE);
-          }
-          continue;
-        }
-        
-        if ((block_num == NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
-            && inode->doubly_indirect_block == 0)
-          // allocate doubly indirect block
-        {
-            inode->doubly_indirect_block = sector;
-            block_write (fs_device, sector, zeros);
-            block_num -- ;
-            continue;
-        }
-        if (block_num >= NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
-        {
-          indirect_block_num = ( block_num - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) / BLOCKS_PER_INDIRECT;
-          final_block_index = ( block_num - (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT )) % BLOCKS_PER_INDIRECT;
-
-          if ((final_block_index == 0) && 
-              (db_ind_block_buf[indirect_block_num] == 0))// new indirect block
-          {
-            db_ind_block_buf[indirect_block_num] = sector;
-            block_write (fs_device, sector, zeros);
-            block_num--;
-            continue;
-          }
-          ind_block_buf[final_block_index] = sector;
-          block_write (fs_device, sector, zeros);
-
-          if ((block_num == new_sectors - 1) || (final_block_index == BLOCKS_PER_INDIRECT - 1)) 
-          //last block or end of indirect block
-          {
-            block_write (fs_device, db_ind_block_buf[indirect_block_num], ind_block_buf);
-            memset (ind_block_buf, 0, BLOCK_SECTOR_SIZE);
-          }
-          if ((block_num == new_sectors - 1) ) 
-          //last block 
-          {
-            block_write (fs_device, inode->doubly_indirect_block, db_ind_block_buf);
-            memset (db_ind_block_buf, 0, BLOCK_SECTOR_SIZE);
-          } 
-        }
+      tmpfs_resize (inode->mem, old_cnt);
+      return false;
     }
-    else
-    {
-      success = false;
+    inode->data.sector_cnt = new_cnt;
+    return true;
+  }
 
+  contiguous = num_blocks_to_add > 1
+               && free_map_allocate (num_blocks_to_add, &start);
+  for (idx = old_cnt; idx < new_cnt; idx++)
+  {
+    block_sector_t sector = start + (idx - old_cnt);
 
-      //write all outstanding buffers to disk.
-      // This makes rolling back easier
-      if (inode->indirect_block !=0)
-      {
-        if (inode->doubly_indirect_block !=0)
-        {
-          block_write (fs_device, db_ind_block_buf[indirect_block_num], ind_block_buf);
-          block_write (fs_device, inode->doubly_indirect_block, db_ind_block_buf);
-        }
-        else
-        {
-          block_write (fs_device, inode->indirect_block, ind_block_buf);
-        }
-      }
+    if (!contiguous && !free_map_allocate (1, &sector))
+      break;
+    if (!install_block (inode, idx, sector))
+    {
+      if (!contiguous)
+        free_map_release (sector, 1);
       break;
     }
+    inode->data.sector_cnt = idx + 1;
   }
 
-  if (success == false) //allocation fails along the way, roll back allocations
+  if (inode->data.sector_cnt < new_cnt)
   {
-    inode_release_allocated_sectors (inode, original_inode_sectors);
+    if (contiguous)
+      free_map_release (start + (inode->data.sector_cnt - old_cnt),
+                        new_cnt - inode->data.sector_cnt);
+    inode_release_allocated_sectors (inode, inode->data.sector_cnt - old_cnt);
+    return false;
   }
+  return true;
+}
 
-  return success;
+/* Returns the number of reads and writes through the inode layer
+   so far. */
+unsigned
+inode_io_cnt (void)
+{
+  return io_cnt;
+}
+
+/* Returns the number of contiguous runs INODE's data sectors form
+   on disk: 1 for a contiguous file, 0 for an empty or in-memory
+   one. */
+size_t
+inode_fragments (const struct inode *inode)
+{
+  block_sector_t prev = 0;
+  size_t runs = 0;
+  size_t idx;
 
+  if (inode->mem != NULL)
+    return 0;
+  for (idx = 0; idx < inode->data.sector_cnt; idx++)
+  {
+    block_sector_t sector = lookup_block (inode, idx);
+    if (idx == 0 || sector != prev + 1)
+      runs++;
+    prev = sector;
+  }
+  return runs;
+}
+
+/* Moves INODE's data sectors into one contiguous run, if they
+   are in more than one and the free map has a run that long.
+   INODE must be open only by the caller; anyone opening it
+   meanwhile makes the move stop early, as does defrag_pace(),
+   called every DEFRAG_CHUNK sectors, returning false.
+   The copy is written back before the block pointers are switched
+   and written back, and the old sectors are freed only after
+   that, so a crash leaves one copy or the other in use.
+   Returns true if INODE was moved. */
+bool
+inode_defrag (struct inode *inode)
+{
+  size_t cnt = inode->data.sector_cnt;
+  block_sector_t *old = NULL;
+  block_sector_t start;
+  uint8_t *buf = NULL;
+  bool moved = false;
+  size_t idx;
+
+  lock_acquire (&inode_list_lock);
+  if (inode->open_cnt != 1 || inode->removed || inode->mem != NULL)
+  {
+    lock_release (&inode_list_lock);
+    return false;
+  }
+  inode->moving = true;
+  inode->move_aborted = false;
+  lock_release (&inode_list_lock);
+
+  if (cnt < 2 || inode_fragments (inode) < 2)
+    goto done;
+  old = malloc (cnt * sizeof *old);
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (old == NULL || buf == NULL || !free_map_allocate (cnt, &start))
+    goto done;
+
+  /* Copy the data into the new run. */
+  for (idx = 0; idx < cnt; idx++)
+  {
+    if (idx % DEFRAG_CHUNK == 0
+        && (inode->move_aborted || !defrag_pace ()))
+      break;
+    old[idx] = lookup_block (inode, idx);
+    cache_read (old[idx], buf);
+    cache_write (start + idx, buf, inode->sector);
+  }
+  if (idx < cnt)
+  {
+    for (idx = 0; idx < cnt; idx++)
+      cache_discard (start + idx);
+    free_map_release (start, cnt);
+    goto done;
+  }
+  cache_flush_owner (inode->sector);
+
+  /* Point the inode at it. */
+  for (idx = 0; idx < cnt; idx++)
+    install_block (inode, idx, start + idx);
+  write_inode (inode);
+  cache_flush_owner (inode->sector);
+  cache_flush_sector (inode->sector);
+  for (idx = 0; idx < cnt; idx++)
+    release_sector (old[idx]);
+  moved = true;
+
+ done:
+  free (old);
+  free (buf);
+  lock_acquire (&inode_list_lock);
+  inode->moving = false;
+  cond_broadcast (&move_done, &inode_list_lock);
+  lock_release (&inode_list_lock);
+  return moved;
 }
 
 bool 
 inode_is_directory (struct inode *inode)
 {
-  return inode->is_dir;
+  return inode->data.is_dir;
 }
 
 bool
@@ -703,10 +1295,34 @@ inode_is_removed (struct inode *inode)
   return inode->removed;
 }
 
+/* Stores INODE's metadata into ST.  Pintos has no hard links,
+   so a file is named by exactly one directory entry and a
+   directory by its parent's entry and its own ".". */
+void
+inode_stat (struct inode *inode, struct stat *st)
+{
+  st->inumber = inode->sector;
+  st->size = inode->data.length;
+  st->is_dir = inode->data.is_dir;
+  st->nlink = inode->data.is_dir ? 2 : 1;
+}
+
 struct lock *
 inode_get_dir_lock (struct inode *inode)
 {
   return &inode->dir_lock;
 }
 
+/* Returns the directory free-slot hint of INODE: no directory
+   entry before this offset is free. */
+off_t
+inode_get_free_slot (struct inode *inode)
+{
+  return inode->free_slot;
+}
 
+void
+inode_set_free_slot (struct inode *inode, off_t ofs)
+{
+  inode->free_slot = ofs;
+}
@@ -2,13 +2,26 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
+struct tmpfs_node;
+
+/* File metadata as filled in by inode_stat().
+   Must match struct stat in lib/user/syscall.h. */
+struct stat
+  {
+    int inumber;                        /* Inode number. */
+    off_t size;                         /* Size in bytes. */
+    bool is_dir;                        /* Is the inode a directory? */
+    int nlink;                          /* Number of links to the inode. */
+  };
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool is_dir);
+bool inode_create_in (struct tmpfs_node *, block_sector_t, off_t, bool is_dir);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
@@ -16,13 +29,24 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+                     off_t src_ofs, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 void inode_release_allocated_sectors (struct inode *inode, int num_blocks_to_remove);
 bool inode_extend (struct inode *inode, int num_blocks_to_add);
+bool inode_allocate (struct inode *inode, off_t length);
+bool inode_truncate (struct inode *inode, off_t length);
 bool inode_is_directory (struct inode *inode);
 bool inode_is_removed (struct inode *inode);
+void inode_stat (struct inode *inode, struct stat *st);
+void inode_sync (struct inode *inode, bool data_only);
 struct lock *inode_get_dir_lock (struct inode *inode);
+off_t inode_get_free_slot (struct inode *inode);
+void inode_set_free_slot (struct inode *inode, off_t ofs);
+unsigned inode_io_cnt (void);
+size_t inode_fragments (const struct inode *);
+bool inode_defrag (struct inode *);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,349 @@
+#include "filesys/procfs.h"
+#include <debug.h>
+#include <list.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "filesys/tmpfs.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/exception.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/swap.h"
+#endif
+
+/* Inode numbers. */
+#define PROCFS_STATS (PROCFS_ROOT + 1)          /* /proc/stats. */
+#define PROCFS_MEMORY (PROCFS_ROOT + 2)         /* /proc/memory. */
+#define PROCFS_IO (PROCFS_ROOT + 3)             /* /proc/io. */
+#define PROCFS_PID_BASE (PROCFS_ROOT + 0x100)   /* /proc/<pid>. */
+
+/* Contents being rendered into a page. */
+struct text
+  {
+    char *buf;                          /* Page. */
+    size_t len;                         /* Bytes used. */
+  };
+
+static bool render_root (struct text *);
+static bool render_stats (struct text *);
+static bool render_memory (struct text *);
+static bool render_io (struct text *);
+static bool render_process (struct text *, tid_t);
+
+/* Returns true if INUMBER is a procfs inode number. */
+bool
+procfs_is_inumber (block_sector_t inumber)
+{
+  return inumber >= PROCFS_ROOT;
+}
+
+/* Renders a snapshot of procfs inode INUMBER into a new tmpfs
+   node of the same number and returns it, for inode_open() to
+   open.  Returns a null pointer if there is no such inode or
+   memory is short. */
+struct tmpfs_node *
+procfs_render (block_sector_t inumber)
+{
+  struct tmpfs_node *node = NULL;
+  struct text t;
+  bool is_dir = inumber == PROCFS_ROOT;
+  bool found;
+  size_t i;
+
+  t.buf = palloc_get_page (PAL_ZERO);
+  t.len = 0;
+  if (t.buf == NULL)
+    return NULL;
+  if (inumber == PROCFS_ROOT)
+    found = render_root (&t);
+  else if (inumber == PROCFS_STATS)
+    found = render_stats (&t);
+  else if (inumber == PROCFS_MEMORY)
+    found = render_memory (&t);
+  else if (inumber == PROCFS_IO)
+    found = render_io (&t);
+  else
+    found = render_process (&t, inumber - PROCFS_PID_BASE);
+
+  if (found)
+    node = tmpfs_alloc_snapshot (inumber);
+  if (node != NULL)
+    {
+      if (inode_create_in (node, inumber, t.len, is_dir))
+        for (i = 0; i * BLOCK_SECTOR_SIZE < t.len; i++)
+          memcpy (tmpfs_block (node, i), t.buf + i * BLOCK_SECTOR_SIZE,
+                  BLOCK_SECTOR_SIZE);
+      else
+        {
+          tmpfs_free (node);
+          node = NULL;
+        }
+    }
+  palloc_free_page (t.buf);
+  return node;
+}
+
+/* Appends FORMAT, formatted as with printf(), to T, truncating
+   at the end of its page. */
+static void
+append (struct text *t, const char *format, ...)
+{
+  va_list args;
+  int n;
+
+  va_start (args, format);
+  n = vsnprintf (t->buf + t->len, PGSIZE - t->len, format, args);
+  va_end (args);
+  t->len += n < (int) (PGSIZE - t->len) ? (size_t) n : PGSIZE - t->len - 1;
+}
+
+/* Lists the other procfs files: one per system-wide file and one
+   per process. */
+static bool
+render_root (struct text *t)
+{
+  size_t idx = 0;
+  off_t len;
+  struct list_elem *e;
+
+  t->len = dir_put_entry (t->buf, PGSIZE, idx++, ".", PROCFS_ROOT, true);
+  t->len = dir_put_entry (t->buf, PGSIZE, idx++, "..", ROOT_DIR_SECTOR, true);
+  t->len = dir_put_entry (t->buf, PGSIZE, idx++, "stats", PROCFS_STATS, false);
+  t->len = dir_put_entry (t->buf, PGSIZE, idx++, "memory", PROCFS_MEMORY,
+                          false);
+  t->len = dir_put_entry (t->buf, PGSIZE, idx++, "io", PROCFS_IO, false);
+
+  lock_acquire (&process_lock);
+  for (e = list_begin (&process_list); e != list_end (&process_list);
+       e = list_next (e))
+    {
+      struct process *p = list_entry (e, struct process, elem);
+      char name[NAME_MAX + 1];
+
+      snprintf (name, sizeof name, "%d", p->tid);
+      len = dir_put_entry (t->buf, PGSIZE, idx++, name,
+                           PROCFS_PID_BASE + p->tid, false);
+      if (len == 0)
+        break;
+      t->len = len;
+    }
+  lock_release (&process_lock);
+  return true;
+}
+
+/* Threads in each state, counted by count_thread(). */
+struct thread_counts
+  {
+    int total;
+    int by_status[THREAD_DYING + 1];
+  };
+
+static void
+count_thread (struct thread *t, void *counts_)
+{
+  struct thread_counts *counts = counts_;
+
+  counts->total++;
+  counts->by_status[t->status]++;
+}
+
+/* Shows scheduler, exception and block device statistics, the
+   ones printed at shutdown. */
+static bool
+render_stats (struct text *t)
+{
+  struct thread_counts counts;
+  long long idle, kernel, user;
+  enum intr_level old_level;
+  struct block *block;
+
+  memset (&counts, 0, sizeof counts);
+  old_level = intr_disable ();
+  thread_foreach (count_thread, &counts);
+  intr_set_level (old_level);
+  thread_get_stats (&idle, &kernel, &user);
+
+  append (t, "ticks: %lld\n", timer_ticks ());
+  append (t, "idle_ticks: %lld\n", idle);
+  append (t, "kernel_ticks: %lld\n", kernel);
+  append (t, "user_ticks: %lld\n", user);
+  if (thread_mlfqs)
+    {
+      int load_avg = thread_get_load_avg ();
+      append (t, "load_avg: %d.%02d\n", load_avg / 100, load_avg % 100);
+    }
+  append (t, "threads: %d\n", counts.total);
+  append (t, "threads_running: %d\n", counts.by_status[THREAD_RUNNING]);
+  append (t, "threads_ready: %d\n", counts.by_status[THREAD_READY]);
+  append (t, "threads_blocked: %d\n", counts.by_status[THREAD_BLOCKED]);
+  append (t, "page_faults: %lld\n", exception_page_fault_cnt ());
+  for (block = block_first (); block != NULL; block = block_next (block))
+    {
+      struct block_stats stats;
+
+      block_get_stats (block, &stats);
+      append (t, "%s_reads: %llu\n", block_name (block), stats.read_cnt);
+      append (t, "%s_writes: %llu\n", block_name (block), stats.write_cnt);
+    }
+  return true;
+}
+
+/* Appends the nonempty buckets of latency HISTOGRAM of BLOCK,
+   labeled NAME, as bucket upper bounds in microseconds and
+   counts. */
+static void
+append_latency (struct text *t, struct block *block, const char *name,
+                const unsigned long long *histogram)
+{
+  int i;
+
+  append (t, "%s_%s_latency:", block_name (block), name);
+  for (i = 0; i < BLOCK_LATENCY_BUCKETS; i++)
+    if (histogram[i] != 0)
+      append (t, " %s%llu:%llu", i < BLOCK_LATENCY_BUCKETS - 1 ? "<" : ">=",
+              1ULL << (i < BLOCK_LATENCY_BUCKETS - 1 ? i : i - 1),
+              histogram[i]);
+  append (t, "\n");
+}
+
+/* Shows each block device's request mix, queue depth and latency
+   histograms. */
+static bool
+render_io (struct text *t)
+{
+  struct block *block;
+  int c;
+
+  for (block = block_first (); block != NULL; block = block_next (block))
+    {
+      struct block_stats stats;
+      const char *name = block_name (block);
+
+      block_get_stats (block, &stats);
+      if (stats.sequential_cnt + stats.random_cnt == 0)
+        continue;
+      append (t, "%s_sequential: %llu\n", name, stats.sequential_cnt);
+      append (t, "%s_random: %llu\n", name, stats.random_cnt);
+      for (c = 0; c < BLOCK_IO_CLASS_CNT; c++)
+        append (t, "%s_%s: %llu\n", name, block_io_class_name (c),
+                stats.class_cnt[c]);
+      append (t, "%s_depth_avg: %u.%02u\n", name,
+              stats.avg_depth_x100 / 100, stats.avg_depth_x100 % 100);
+      append (t, "%s_depth_max: %u\n", name, stats.max_depth);
+      append_latency (t, block, "read", stats.read_latency);
+      append_latency (t, block, "write", stats.write_latency);
+    }
+  return true;
+}
+
+/* Shows frame table, swap and tmpfs occupancy. */
+static bool
+render_memory (struct text *t)
+{
+#ifdef VM
+  append (t, "frames_used: %zu\n", frame_used_cnt ());
+  append (t, "frames_total: %zu\n", frame_total_cnt ());
+  append (t, "swap_slots_used: %zu\n", swap_used_cnt ());
+  append (t, "swap_slots_total: %zu\n", swap_total_cnt ());
+  append (t, "swap_cache_hits: %llu\n", swap_cache_hit_cnt ());
+#endif
+  append (t, "tmpfs_pages: %zu\n", tmpfs_used_pages ());
+  return true;
+}
+
+/* Fields of a process's thread, copied by copy_thread(). */
+struct thread_info
+  {
+    tid_t tid;                          /* Thread to look for. */
+    bool found;                         /* Found it? */
+    char name[16];
+    enum thread_status status;
+    int priority;
+    int nice;
+    size_t open_files;
+    size_t mmaps;
+  };
+
+static void
+copy_thread (struct thread *t, void *info_)
+{
+  struct thread_info *info = info_;
+
+  if (t->tid != info->tid)
+    return;
+  info->found = true;
+  strlcpy (info->name, t->name, sizeof info->name);
+  info->status = t->status;
+  info->priority = t->priority;
+  info->nice = t->nice;
+  info->open_files = list_size (&t->open_files);
+  info->mmaps = list_size (&t->mmapped_files);
+}
+
+/* Shows the state of process TID.  Returns false if there is no
+   such process. */
+static bool
+render_process (struct text *t, tid_t tid)
+{
+  static const char *status_names[] = {"running", "ready", "blocked",
+                                       "dying"};
+  struct thread_info info;
+  enum intr_level old_level;
+  struct process *p = NULL;
+  struct list_elem *e;
+  tid_t parent_tid = 0;
+  bool finished = false;
+  int exit_code = 0;
+  size_t pages = 0;
+
+  lock_acquire (&process_lock);
+  for (e = list_begin (&process_list); e != list_end (&process_list);
+       e = list_next (e))
+    {
+      p = list_entry (e, struct process, elem);
+      if (p->tid == tid)
+        {
+          parent_tid = p->parent_tid;
+          finished = p->finished;
+          exit_code = p->exit_code;
+          if (!finished)
+            pages = hash_size (&p->supp_page_table);
+          break;
+        }
+    }
+  lock_release (&process_lock);
+  if (e == list_end (&process_list))
+    return false;
+
+  memset (&info, 0, sizeof info);
+  info.tid = tid;
+  old_level = intr_disable ();
+  thread_foreach (copy_thread, &info);
+  intr_set_level (old_level);
+
+  append (t, "pid: %d\n", tid);
+  append (t, "parent: %d\n", parent_tid);
+  if (finished || !info.found)
+    {
+      append (t, "state: exited\n");
+      append (t, "exit_code: %d\n", exit_code);
+      return true;
+    }
+  append (t, "name: %s\n", info.name);
+  append (t, "state: %s\n", status_names[info.status]);
+  append (t, "priority: %d\n", info.priority);
+  append (t, "nice: %d\n", info.nice);
+  append (t, "open_files: %zu\n", info.open_files);
+  append (t, "mmaps: %zu\n", info.mmaps);
+  append (t, "pages: %zu\n", pages);
+  return true;
+}
@@ -0,0 +1,20 @@
+#ifndef FILESYS_PROCFS_H
+#define FILESYS_PROCFS_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+struct tmpfs_node;
+
+/* A read-only file system mounted as PROCFS_MOUNT_NAME in the
+   root directory that shows kernel, process and memory state.
+   Each of its inodes, numbered from PROCFS_ROOT up, is rendered
+   into a tmpfs node when it is opened and stays the same until
+   it is closed by all its openers. */
+#define PROCFS_ROOT 0x60000000  /* Inode number of procfs root. */
+#define PROCFS_MOUNT_NAME "proc" /* Name of mount point in root. */
+
+bool procfs_is_inumber (block_sector_t);
+struct tmpfs_node *procfs_render (block_sector_t);
+
+#endif /* filesys/procfs.h */
@@ -0,0 +1,226 @@
+#include "filesys/tmpfs.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/procfs.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Sectors' worth of data per page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Data pages one tmpfs file can have: as many as fit in its
+   page of page pointers, 4 MB. */
+#define MAX_FILE_PAGES (PGSIZE / sizeof (uint8_t *))
+
+/* Data pages all tmpfs files together may take from the kernel
+   pool, so that scratch files cannot starve the kernel.  procfs
+   snapshots, which last only while open, are not counted. */
+#define TMPFS_MAX_PAGES 128
+
+/* A tmpfs inode. */
+struct tmpfs_node
+  {
+    struct list_elem elem;              /* Element in node list. */
+    block_sector_t inumber;             /* Inode number. */
+    uint8_t inode[BLOCK_SECTOR_SIZE];   /* Stands in for inode sector. */
+    uint8_t **pages;                    /* Data pages, or null. */
+    size_t page_cnt;                    /* Number of data pages. */
+    bool snapshot;                      /* procfs snapshot, not listed
+                                           or counted in used_pages? */
+  };
+
+static struct list nodes;               /* All tmpfs inodes. */
+static struct lock tmpfs_lock;          /* Protects the above and below. */
+static block_sector_t next_inumber;     /* Next inode number to try. */
+static size_t used_pages;               /* Data pages in use. */
+
+/* Initializes tmpfs with an empty root inode, which the caller
+   must make into a directory with dir_create(). */
+void
+tmpfs_init (void) 
+{
+  block_sector_t root;
+
+  list_init (&nodes);
+  lock_init (&tmpfs_lock);
+  next_inumber = TMPFS_ROOT;
+  if (!tmpfs_alloc (&root) || root != TMPFS_ROOT)
+    PANIC ("tmpfs initialization failed");
+}
+
+/* Returns true if INUMBER is a tmpfs inode number. */
+bool
+tmpfs_is_inumber (block_sector_t inumber) 
+{
+  return inumber >= TMPFS_ROOT && inumber < PROCFS_ROOT;
+}
+
+/* Returns the node numbered INUMBER, or a null pointer.
+   The caller must hold tmpfs_lock. */
+static struct tmpfs_node *
+find_node (block_sector_t inumber) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&nodes); e != list_end (&nodes); e = list_next (e))
+    {
+      struct tmpfs_node *node = list_entry (e, struct tmpfs_node, elem);
+      if (node->inumber == inumber)
+        return node;
+    }
+  return NULL;
+}
+
+/* Allocates a new, empty tmpfs inode and stores its number into
+   *INUMBERP, for inode_create() to initialize.
+   Returns false if memory is short. */
+bool
+tmpfs_alloc (block_sector_t *inumberp) 
+{
+  struct tmpfs_node *node = calloc (1, sizeof *node);
+  if (node == NULL)
+    return false;
+
+  lock_acquire (&tmpfs_lock);
+  while (find_node (next_inumber) != NULL)
+    if (++next_inumber == PROCFS_ROOT)
+      next_inumber = TMPFS_ROOT;
+  node->inumber = *inumberp = next_inumber++;
+  if (next_inumber == PROCFS_ROOT)
+    next_inumber = TMPFS_ROOT;
+  list_push_back (&nodes, &node->elem);
+  lock_release (&tmpfs_lock);
+  return true;
+}
+
+/* Allocates and returns a new, empty node numbered INUMBER,
+   which is outside tmpfs's own range of inode numbers, for a
+   procfs snapshot.  Only the caller refers to it: tmpfs_lookup()
+   does not find it, and its pages do not count against
+   TMPFS_MAX_PAGES.  Returns a null pointer if memory is short. */
+struct tmpfs_node *
+tmpfs_alloc_snapshot (block_sector_t inumber) 
+{
+  struct tmpfs_node *node = calloc (1, sizeof *node);
+
+  ASSERT (!tmpfs_is_inumber (inumber));
+  if (node != NULL)
+    {
+      node->inumber = inumber;
+      node->snapshot = true;
+    }
+  return node;
+}
+
+/* Returns the tmpfs inode numbered INUMBER, or a null pointer if
+   there is none. */
+struct tmpfs_node *
+tmpfs_lookup (block_sector_t inumber) 
+{
+  struct tmpfs_node *node;
+
+  lock_acquire (&tmpfs_lock);
+  node = find_node (inumber);
+  lock_release (&tmpfs_lock);
+  return node;
+}
+
+/* Frees NODE and its data. */
+void
+tmpfs_free (struct tmpfs_node *node) 
+{
+  if (node == NULL)
+    return;
+  tmpfs_resize (node, 0);
+  if (!node->snapshot)
+    {
+      lock_acquire (&tmpfs_lock);
+      list_remove (&node->elem);
+      lock_release (&tmpfs_lock);
+    }
+  palloc_free_page (node->pages);
+  free (node);
+}
+
+/* Returns the number of data pages all tmpfs files use. */
+size_t
+tmpfs_used_pages (void) 
+{
+  return used_pages;
+}
+
+/* Returns the BLOCK_SECTOR_SIZE bytes that hold NODE's on-disk
+   inode, as its sector would on disk. */
+void *
+tmpfs_inode (struct tmpfs_node *node) 
+{
+  return node->inode;
+}
+
+/* Returns data block IDX of NODE, which must be less than the
+   sector count it was last resized to. */
+uint8_t *
+tmpfs_block (struct tmpfs_node *node, size_t idx) 
+{
+  ASSERT (idx / SECTORS_PER_PAGE < node->page_cnt);
+  return node->pages[idx / SECTORS_PER_PAGE]
+         + idx % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE;
+}
+
+/* Gives NODE room for exactly SECTOR_CNT data blocks, freeing
+   pages past the end or adding zeroed ones.  The caller
+   serializes resizes of a node, as inode.c does with its
+   extend_lock.  Returns false if tmpfs is full. */
+bool
+tmpfs_resize (struct tmpfs_node *node, size_t sector_cnt) 
+{
+  size_t page_cnt = DIV_ROUND_UP (sector_cnt, SECTORS_PER_PAGE);
+
+  if (page_cnt > MAX_FILE_PAGES)
+    return false;
+  if (node->pages == NULL)
+    {
+      if (page_cnt == 0)
+        return true;
+      node->pages = palloc_get_page (PAL_ZERO);
+      if (node->pages == NULL)
+        return false;
+    }
+
+  while (node->page_cnt > page_cnt)
+    {
+      palloc_free_page (node->pages[--node->page_cnt]);
+      node->pages[node->page_cnt] = NULL;
+      if (node->snapshot)
+        continue;
+      lock_acquire (&tmpfs_lock);
+      used_pages--;
+      lock_release (&tmpfs_lock);
+    }
+  while (node->page_cnt < page_cnt)
+    {
+      uint8_t *page = NULL;
+
+      if (node->snapshot)
+        page = palloc_get_page (PAL_ZERO);
+      else
+        {
+          lock_acquire (&tmpfs_lock);
+          if (used_pages < TMPFS_MAX_PAGES)
+            {
+              page = palloc_get_page (PAL_ZERO);
+              if (page != NULL)
+                used_pages++;
+            }
+          lock_release (&tmpfs_lock);
+        }
+      if (page == NULL)
+        return false;
+      node->pages[node->page_cnt++] = page;
+    }
+  return true;
+}
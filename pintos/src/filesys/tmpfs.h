@@ -0,0 +1,32 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+/* A file system held entirely in kernel pages, mounted as
+   TMPFS_MOUNT_NAME in the root directory.  Its inodes are
+   ordinary `struct inode's (see inode.c) whose inode numbers are
+   at least TMPFS_ROOT, far above any disk sector, and below
+   PROCFS_ROOT, and whose data never goes through the buffer
+   cache or the disk. */
+#define TMPFS_ROOT 0x40000000   /* Inode number of tmpfs root. */
+#define TMPFS_MOUNT_NAME "tmp"  /* Name of mount point in root. */
+
+struct tmpfs_node;
+
+void tmpfs_init (void);
+bool tmpfs_is_inumber (block_sector_t);
+bool tmpfs_alloc (block_sector_t *);
+struct tmpfs_node *tmpfs_alloc_snapshot (block_sector_t);
+struct tmpfs_node *tmpfs_lookup (block_sector_t);
+void tmpfs_free (struct tmpfs_node *);
+
+void *tmpfs_inode (struct tmpfs_node *);
+uint8_t *tmpfs_block (struct tmpfs_node *, size_t idx);
+bool tmpfs_resize (struct tmpfs_node *, size_t sector_cnt);
+size_t tmpfs_used_pages (void);
+
+#endif /* filesys/tmpfs.h */
@@ -28,7 +28,22 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_GETDENTS,               /* Reads many directory entries. */
+    SYS_STAT,                   /* Obtains metadata for a file name. */
+    SYS_FSTAT,                  /* Obtains metadata for a fd. */
+    SYS_PREAD,                  /* Reads from a file at an offset. */
+    SYS_PWRITE,                 /* Writes to a file at an offset. */
+    SYS_READV,                  /* Reads into several buffers. */
+    SYS_WRITEV,                 /* Writes from several buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copies data between two files. */
+    SYS_FSYNC,                  /* Writes a file's data and metadata to disk. */
+    SYS_FDATASYNC,              /* Writes a file's data to disk. */
+    SYS_OPEN_FLAGS,             /* Opens a file with flags. */
+    SYS_FALLOCATE,              /* Reserves space for a file. */
+    SYS_FTRUNCATE               /* Changes the length of a file. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -2,6 +2,7 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -15,6 +16,37 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry, as read by getdents(). */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    bool is_dir;                        /* Is the entry a directory? */
+    char name[READDIR_MAX_LEN + 1];     /* Null-terminated file name. */
+  };
+
+/* File metadata, as returned by stat() and fstat(). */
+struct stat
+  {
+    int inumber;                        /* Inode number. */
+    int size;                           /* Size in bytes. */
+    bool is_dir;                        /* Is the file a directory? */
+    int nlink;                          /* Number of links to the file. */
+  };
+
+/* One buffer of a readv() or writev() request. */
+struct iovec
+  {
+    void *iov_base;                     /* Start of buffer. */
+    size_t iov_len;                     /* Number of bytes in buffer. */
+  };
+
+/* Maximum number of buffers in a readv() or writev() request. */
+#define IOV_MAX 1024
+
+/* Flags for open_flags(). */
+#define O_SYNC 1                /* Every write is followed by fsync(). */
+#define O_DSYNC 2               /* Every write is followed by fdatasync(). */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +77,19 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int getdents (int fd, struct dirent *, unsigned cnt);
+bool stat (const char *file, struct stat *);
+bool fstat (int fd, struct stat *);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+bool fsync (int fd);
+bool fdatasync (int fd);
+int open_flags (const char *file, int flags);
+bool fallocate (int fd, unsigned length);
+bool ftruncate (int fd, unsigned length);
+
 #endif /* lib/user/syscall.h */
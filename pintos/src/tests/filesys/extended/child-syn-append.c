@@ -0,0 +1,78 @@
+/* Child process for syn-append.
+   Children 0 and 1 append their records to the append file,
+   each writing past the other's end of file.  Child 2 reads the
+   grow file as our parent grows it, checking that every byte a
+   read returns has been written: a writer's bytes may only
+   become readable once it has copied them in.  Like
+   child-syn-rw, it busy-waits for the file to grow. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-append.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-append";
+
+static char buf[GROW_SIZE];
+
+/* Appends every other record of the append file, starting with
+   record slot FIRST. */
+static void
+append_records (int first)
+{
+  int fd, slot;
+
+  CHECK ((fd = open (append_file)) > 1, "open \"%s\"", append_file);
+  for (slot = first; slot < 2 * RECORD_CNT; slot += 2)
+    {
+      size_t i;
+
+      for (i = 0; i < RECORD_SIZE; i++)
+        buf[i] = record_byte (slot);
+      CHECK (pwrite (fd, buf, RECORD_SIZE, slot * RECORD_SIZE)
+             == RECORD_SIZE, "write record %d to \"%s\"", slot, append_file);
+    }
+  close (fd);
+}
+
+/* Reads the grow file until all of it has been read. */
+static void
+follow_growth (void)
+{
+  size_t ofs = 0;
+  int fd;
+
+  CHECK ((fd = open (grow_file)) > 1, "open \"%s\"", grow_file);
+  while (ofs < sizeof buf)
+    {
+      int bytes_read = read (fd, buf + ofs, sizeof buf - ofs);
+      int i;
+
+      CHECK (bytes_read >= 0 && bytes_read <= (int) (sizeof buf - ofs),
+             "%zu-byte read on \"%s\" returned invalid value of %d",
+             sizeof buf - ofs, grow_file, bytes_read);
+      for (i = 0; i < bytes_read; i++, ofs++)
+        if (buf[ofs] != grow_byte (ofs))
+          fail ("byte %zu of \"%s\" read as %02hhx instead of %02hhx",
+                ofs, grow_file, buf[ofs], grow_byte (ofs));
+    }
+  close (fd);
+}
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  if (child_idx < 2)
+    append_records (child_idx);
+  else
+    follow_growth ();
+
+  return child_idx;
+}
@@ -0,0 +1,50 @@
+/* Child process for truncate-race.
+   Child 0 reads the whole file over and over, checking that
+   every byte is either zero, from a truncation, or 'x', from
+   child 1, which overwrites the whole file with 'x' over and
+   over.  Either may see the file at any length in between. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/truncate-race.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-trunc-race";
+
+static char buf[FILE_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+  int fd, round;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  memset (buf, 'x', sizeof buf);
+  for (round = 0; round < ROUND_CNT; round++)
+    if (child_idx == 0)
+      {
+        int bytes_read = pread (fd, buf, sizeof buf, 0);
+        int i;
+
+        CHECK (bytes_read >= 0 && bytes_read <= (int) sizeof buf,
+               "%zu-byte read on \"%s\" returned invalid value of %d",
+               sizeof buf, file_name, bytes_read);
+        for (i = 0; i < bytes_read; i++)
+          if (buf[i] != 0 && buf[i] != 'x')
+            fail ("byte %d of \"%s\" is %02hhx, not 00 or 'x'",
+                  i, file_name, buf[i]);
+      }
+    else
+      CHECK (pwrite (fd, buf, sizeof buf, 0) == (int) sizeof buf,
+             "write %zu bytes to \"%s\"", sizeof buf, file_name);
+  close (fd);
+
+  return child_idx;
+}
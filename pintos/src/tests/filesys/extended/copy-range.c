@@ -0,0 +1,52 @@
+/* Copies a multi-sector file with copy_file_range(), starting
+   from an unaligned position, and checks the copy's contents
+   and both files' positions. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SRC_SIZE 6000
+#define SKIP 100
+
+static char src[SRC_SIZE];
+static char buf[SRC_SIZE];
+
+void
+test_main (void) 
+{
+  int in_fd, out_fd;
+  int total, cnt;
+
+  random_init (0);
+  random_bytes (src, sizeof src);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((in_fd = open ("a")) > 1, "open \"a\"");
+  CHECK (write (in_fd, src, sizeof src) == sizeof src,
+         "write %d bytes to \"a\"", SRC_SIZE);
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((out_fd = open ("b")) > 1, "open \"b\"");
+
+  seek (in_fd, SKIP);
+  total = 0;
+  while ((cnt = copy_file_range (in_fd, out_fd, 1000)) > 0)
+    total += cnt;
+  CHECK (cnt == 0, "copy_file_range at end of \"a\" returns 0");
+  CHECK (total == SRC_SIZE - SKIP, "copied %d bytes", total);
+  CHECK (tell (in_fd) == SRC_SIZE, "tell \"a\"");
+  CHECK (tell (out_fd) == SRC_SIZE - SKIP, "tell \"b\"");
+  CHECK (filesize (out_fd) == SRC_SIZE - SKIP, "filesize \"b\"");
+
+  CHECK (pread (out_fd, buf, sizeof buf, 0) == SRC_SIZE - SKIP, "read \"b\"");
+  if (memcmp (buf, src + SKIP, SRC_SIZE - SKIP))
+    fail ("\"b\" does not match \"a\"");
+
+  seek (in_fd, 0);
+  CHECK (copy_file_range (in_fd, in_fd, 10) == -1,
+         "copy \"a\" onto itself (must return -1)");
+  close (in_fd);
+  close (out_fd);
+}
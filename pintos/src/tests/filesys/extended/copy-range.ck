@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range) begin
+(copy-range) create "a"
+(copy-range) open "a"
+(copy-range) write 6000 bytes to "a"
+(copy-range) create "b"
+(copy-range) open "b"
+(copy-range) copy_file_range at end of "a" returns 0
+(copy-range) copied 5900 bytes
+(copy-range) tell "a"
+(copy-range) tell "b"
+(copy-range) filesize "b"
+(copy-range) read "b"
+(copy-range) copy "a" onto itself (must return -1)
+(copy-range) end
+EOF
+pass;
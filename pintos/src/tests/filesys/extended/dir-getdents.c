@@ -0,0 +1,78 @@
+/* Fills a directory with more entries than fit in a single
+   getdents() call, then reads them back in batches and checks
+   that every entry is returned exactly once, with the right
+   type and inode number. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+#define BATCH 8
+
+void
+test_main (void) 
+{
+  struct dirent ents[BATCH];
+  bool seen[FILE_CNT + 1];
+  int fd, cnt, total;
+  int i;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (chdir ("d"), "chdir \"d\"");
+
+  msg ("creating files...");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "f%d", i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+  CHECK (mkdir ("sub"), "mkdir \"sub\"");
+
+  CHECK ((fd = open (".")) > 1, "open \".\"");
+  memset (seen, 0, sizeof seen);
+  total = 0;
+  while ((cnt = getdents (fd, ents, BATCH)) > 0) 
+    {
+      if (cnt > BATCH)
+        fail ("getdents returned %d entries for a %d-entry buffer",
+              cnt, BATCH);
+      for (i = 0; i < cnt; i++) 
+        {
+          int idx, entry_fd;
+
+          if (!strcmp (ents[i].name, "sub"))
+            {
+              if (!ents[i].is_dir)
+                fail ("\"sub\" should be a directory");
+              idx = FILE_CNT;
+            }
+          else 
+            {
+              idx = atoi (ents[i].name + 1);
+              if (ents[i].name[0] != 'f' || idx < 0 || idx >= FILE_CNT)
+                fail ("unexpected entry \"%s\"", ents[i].name);
+              if (ents[i].is_dir)
+                fail ("\"%s\" should not be a directory", ents[i].name);
+            }
+          if (seen[idx])
+            fail ("entry \"%s\" returned twice", ents[i].name);
+          seen[idx] = true;
+
+          entry_fd = open (ents[i].name);
+          if (entry_fd < 0 || inumber (entry_fd) != ents[i].inumber)
+            fail ("wrong inumber for \"%s\"", ents[i].name);
+          close (entry_fd);
+          total++;
+        }
+    }
+  CHECK (cnt == 0, "getdents at end of directory returns 0");
+  CHECK (total == FILE_CNT + 1, "read %d entries", total);
+  close (fd);
+}
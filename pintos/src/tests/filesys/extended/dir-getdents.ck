@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "d"
+(dir-getdents) chdir "d"
+(dir-getdents) creating files...
+(dir-getdents) mkdir "sub"
+(dir-getdents) open "."
+(dir-getdents) getdents at end of directory returns 0
+(dir-getdents) read 41 entries
+(dir-getdents) end
+EOF
+pass;
@@ -0,0 +1,39 @@
+/* Checks fsync() and fdatasync() on files and directories, and
+   writes through a file opened with O_SYNC. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[700];
+
+void
+test_main (void) 
+{
+  int fd, dir_fd;
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = 'a' + i % 26;
+
+  CHECK (create ("f", 0), "create \"f\"");
+  CHECK ((fd = open ("f")) > 1, "open \"f\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"f\"");
+  CHECK (fdatasync (fd), "fdatasync \"f\"");
+  CHECK (fsync (fd), "fsync \"f\"");
+  close (fd);
+
+  CHECK ((dir_fd = open (".")) > 1, "open \".\"");
+  CHECK (fsync (dir_fd), "fsync \".\"");
+  close (dir_fd);
+
+  CHECK (open_flags ("f", 0x100) == -1,
+         "open \"f\" with bad flags (must return -1)");
+  CHECK ((fd = open_flags ("f", O_SYNC)) > 1, "open \"f\" with O_SYNC");
+  seek (fd, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "append to \"f\"");
+  CHECK (filesize (fd) == 2 * sizeof buf, "filesize \"f\"");
+  close (fd);
+
+  CHECK (!fsync (fd), "fsync closed fd (must return false)");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync) begin
+(fsync) create "f"
+(fsync) open "f"
+(fsync) write "f"
+(fsync) fdatasync "f"
+(fsync) fsync "f"
+(fsync) open "."
+(fsync) fsync "."
+(fsync) open "f" with bad flags (must return -1)
+(fsync) open "f" with O_SYNC
+(fsync) append to "f"
+(fsync) filesize "f"
+(fsync) fsync closed fd (must return false)
+(fsync) end
+EOF
+pass;
@@ -0,0 +1,27 @@
+/* Tries to execute files under /proc, which are not programs,
+   both while they are open and while they are not, and checks
+   that exec fails cleanly and leaves them readable. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+  int fd;
+
+  CHECK (exec ("/proc/stats") == -1, "exec \"/proc/stats\" (must return -1)");
+  CHECK (exec ("/proc/memory") == -1,
+         "exec \"/proc/memory\" (must return -1)");
+
+  CHECK ((fd = open ("/proc/io")) > 1, "open \"/proc/io\"");
+  CHECK (exec ("/proc/io") == -1, "exec \"/proc/io\" (must return -1)");
+  CHECK (read (fd, buf, sizeof buf) >= 0, "read \"/proc/io\"");
+  close (fd);
+
+  CHECK ((fd = open ("/proc/stats")) > 1, "open \"/proc/stats\"");
+  CHECK (read (fd, buf, sizeof buf) > 0, "read \"/proc/stats\"");
+  close (fd);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# Each failed exec may print a load error and an exit status for
+# the /proc file, in any order relative to our own messages.
+@output = grep (!/^load: \/proc\/\S+: /
+		&& !/^\/proc\/\S+: exit\(-?\d+\)$/
+		&& !/^procfs-exec: exit\(-?\d+\)$/, @output);
+my ($expected) = <<'EOF';
+(procfs-exec) begin
+(procfs-exec) exec "/proc/stats" (must return -1)
+(procfs-exec) exec "/proc/memory" (must return -1)
+(procfs-exec) open "/proc/io"
+(procfs-exec) exec "/proc/io" (must return -1)
+(procfs-exec) read "/proc/io"
+(procfs-exec) open "/proc/stats"
+(procfs-exec) read "/proc/stats"
+(procfs-exec) end
+EOF
+fail "Output differs from expected:\n" . join ('', map ("  $_\n", @output))
+  if join ('', map ("$_\n", @output)) ne $expected;
+pass;
@@ -0,0 +1,83 @@
+/* Lists /proc, reads its system-wide files and the file of the
+   running process, and checks that nothing under /proc can be
+   written, created or removed. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096];
+
+/* Reads all of the file named NAME into BUF, null-terminated. */
+static void
+read_file (const char *name)
+{
+  int fd, size;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  size = read (fd, buf, sizeof buf - 1);
+  if (size <= 0)
+    fail ("read \"%s\" returned %d", name, size);
+  buf[size] = '\0';
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  char path[32];
+  bool stats = false, memory = false, io = false, self = false;
+  int fd;
+
+  CHECK ((fd = open ("/proc")) > 1, "open \"/proc\"");
+  CHECK (isdir (fd), "isdir \"/proc\"");
+  while (readdir (fd, name))
+    if (!strcmp (name, "stats"))
+      stats = true;
+    else if (!strcmp (name, "memory"))
+      memory = true;
+    else if (!strcmp (name, "io"))
+      io = true;
+    else if (!self)
+      {
+        int pid_fd;
+        int size;
+
+        snprintf (path, sizeof path, "/proc/%s", name);
+        pid_fd = open (path);
+        if (pid_fd < 0)
+          continue;
+        size = read (pid_fd, buf, sizeof buf - 1);
+        buf[size > 0 ? size : 0] = '\0';
+        self = strstr (buf, "name: procfs\n") != NULL
+               && strstr (buf, "state: running\n") != NULL;
+        close (pid_fd);
+      }
+  close (fd);
+  CHECK (stats, "\"stats\" listed in \"/proc\"");
+  CHECK (memory, "\"memory\" listed in \"/proc\"");
+  CHECK (io, "\"io\" listed in \"/proc\"");
+  CHECK (self, "running process listed in \"/proc\"");
+
+  read_file ("/proc/stats");
+  CHECK (strstr (buf, "ticks: ") != NULL, "\"/proc/stats\" has ticks");
+  read_file ("/proc/memory");
+  CHECK (strstr (buf, "tmpfs_pages: ") != NULL,
+         "\"/proc/memory\" has tmpfs_pages");
+  read_file ("/proc/io");
+  CHECK (strstr (buf, "_read_latency:") != NULL,
+         "\"/proc/io\" has read latencies");
+
+  CHECK ((fd = open ("/proc/stats")) > 1, "open \"/proc/stats\"");
+  CHECK (write (fd, "x", 1) == 0, "write \"/proc/stats\" (must return 0)");
+  CHECK (!ftruncate (fd, 0), "ftruncate \"/proc/stats\" (must return false)");
+  close (fd);
+  CHECK (!create ("/proc/f", 0), "create \"/proc/f\" (must return false)");
+  CHECK (!mkdir ("/proc/d"), "mkdir \"/proc/d\" (must return false)");
+  CHECK (!remove ("/proc/stats"),
+         "remove \"/proc/stats\" (must return false)");
+  CHECK (!remove ("/proc"), "remove \"/proc\" (must return false)");
+}
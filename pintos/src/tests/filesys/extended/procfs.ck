@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(procfs) begin
+(procfs) open "/proc"
+(procfs) isdir "/proc"
+(procfs) "stats" listed in "/proc"
+(procfs) "memory" listed in "/proc"
+(procfs) "io" listed in "/proc"
+(procfs) running process listed in "/proc"
+(procfs) open "/proc/stats"
+(procfs) "/proc/stats" has ticks
+(procfs) open "/proc/memory"
+(procfs) "/proc/memory" has tmpfs_pages
+(procfs) open "/proc/io"
+(procfs) "/proc/io" has read latencies
+(procfs) open "/proc/stats"
+(procfs) write "/proc/stats" (must return 0)
+(procfs) ftruncate "/proc/stats" (must return false)
+(procfs) create "/proc/f" (must return false)
+(procfs) mkdir "/proc/d" (must return false)
+(procfs) remove "/proc/stats" (must return false)
+(procfs) remove "/proc" (must return false)
+(procfs) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+sub fill {
+    my ($size, $base) = @_;
+    return join ('', map (chr (ord ($base) + $_ % 23), 0...$size - 1));
+}
+my ($head) = fill (100, 'a');
+my ($c) = fill (37, '0');
+substr ($head, 10, 37) = $c;
+check_archive ({'vec' => [$head . fill (5000, 'A') . $c]});
+pass;
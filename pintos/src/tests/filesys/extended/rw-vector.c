@@ -0,0 +1,71 @@
+/* Writes a file with writev() and pwrite(), then reads it back
+   with pread() and readv(), checking that positional calls leave
+   the file position alone and vectored calls advance it by the
+   total transferred. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char a[100], b[5000], c[37];
+static char buf[sizeof a + sizeof b + sizeof c];
+
+static void
+fill (char *p, size_t size, char base)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = base + i % 23;
+}
+
+void
+test_main (void) 
+{
+  struct iovec iov[3];
+  size_t total = sizeof a + sizeof b + sizeof c;
+  int fd;
+
+  fill (a, sizeof a, 'a');
+  fill (b, sizeof b, 'A');
+  fill (c, sizeof c, '0');
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof a;
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof b;
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof c;
+
+  CHECK (create ("vec", 0), "create \"vec\"");
+  CHECK ((fd = open ("vec")) > 1, "open \"vec\"");
+  CHECK (writev (fd, iov, 3) == (int) total, "writev %zu bytes", total);
+  CHECK (tell (fd) == total, "tell after writev");
+
+  CHECK (pwrite (fd, c, sizeof c, 10) == (int) sizeof c,
+         "pwrite %zu bytes at offset 10", sizeof c);
+  memcpy (a + 10, c, sizeof c);
+  CHECK (tell (fd) == total, "tell unchanged by pwrite");
+
+  CHECK (pread (fd, buf, sizeof buf, 0) == (int) total, "pread whole file");
+  if (memcmp (buf, a, sizeof a)
+      || memcmp (buf + sizeof a, b, sizeof b)
+      || memcmp (buf + sizeof a + sizeof b, c, sizeof c))
+    fail ("pread returned wrong data");
+  CHECK (pread (fd, buf, sizeof buf, total) == 0, "pread at end of file");
+
+  memset (a, 0, sizeof a);
+  memset (b, 0, sizeof b);
+  memset (c, 0, sizeof c);
+  seek (fd, 0);
+  CHECK (readv (fd, iov, 3) == (int) total, "readv %zu bytes", total);
+  CHECK (tell (fd) == total, "tell after readv");
+  if (memcmp (buf, a, sizeof a)
+      || memcmp (buf + sizeof a, b, sizeof b)
+      || memcmp (buf + sizeof a + sizeof b, c, sizeof c))
+    fail ("readv returned wrong data");
+
+  CHECK (readv (fd, iov, 0) == -1, "readv with no buffers (must return -1)");
+  CHECK (pread (1, buf, 1, 0) == -1, "pread stdout (must return -1)");
+  close (fd);
+}
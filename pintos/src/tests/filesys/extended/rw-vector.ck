@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rw-vector) begin
+(rw-vector) create "vec"
+(rw-vector) open "vec"
+(rw-vector) writev 5137 bytes
+(rw-vector) tell after writev
+(rw-vector) pwrite 37 bytes at offset 10
+(rw-vector) tell unchanged by pwrite
+(rw-vector) pread whole file
+(rw-vector) pread at end of file
+(rw-vector) readv 5137 bytes
+(rw-vector) tell after readv
+(rw-vector) readv with no buffers (must return -1)
+(rw-vector) pread stdout (must return -1)
+(rw-vector) end
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Checks that stat() and fstat() report the same size, type
+   and inode number as filesize(), isdir() and inumber(), and
+   that stat() fails for names that do not exist. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[1234];
+
+void
+test_main (void) 
+{
+  struct stat st;
+  int fd;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/f", 0), "create \"d/f\"");
+  CHECK ((fd = open ("d/f")) > 1, "open \"d/f\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write %zu bytes to \"d/f\"", sizeof buf);
+
+  CHECK (stat ("d/f", &st), "stat \"d/f\"");
+  if (st.is_dir || st.size != filesize (fd) || st.inumber != inumber (fd)
+      || st.nlink != 1)
+    fail ("stat \"d/f\" returned wrong metadata");
+  CHECK (fstat (fd, &st), "fstat \"d/f\"");
+  if (st.is_dir || st.size != (int) sizeof buf || st.inumber != inumber (fd))
+    fail ("fstat \"d/f\" returned wrong metadata");
+  close (fd);
+
+  CHECK ((fd = open ("d")) > 1, "open \"d\"");
+  CHECK (stat ("d", &st), "stat \"d\"");
+  if (!st.is_dir || st.inumber != inumber (fd))
+    fail ("stat \"d\" returned wrong metadata");
+  close (fd);
+
+  CHECK (!stat ("d/f/", &st), "stat \"d/f/\" (must return false)");
+  CHECK (!stat ("d/nonexistent", &st),
+         "stat \"d/nonexistent\" (must return false)");
+  CHECK (!fstat (1, &st), "fstat stdout (must return false)");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(stat) begin
+(stat) mkdir "d"
+(stat) create "d/f"
+(stat) open "d/f"
+(stat) write 1234 bytes to "d/f"
+(stat) stat "d/f"
+(stat) fstat "d/f"
+(stat) open "d"
+(stat) stat "d"
+(stat) stat "d/f/" (must return false)
+(stat) stat "d/nonexistent" (must return false)
+(stat) fstat stdout (must return false)
+(stat) end
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($append) = join ('', map (chr (ord ('A') + $_ % 26) x 100, 0...127));
+my ($grow) = join ('', map (chr (ord ('a') + int ($_ / 7) % 26), 0...15999));
+check_archive ({"child-syn-append" => "tests/filesys/extended/child-syn-append",
+		"appendfile" => [$append],
+		"growfile" => [$grow]});
+pass;
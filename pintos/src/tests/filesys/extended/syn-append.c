@@ -0,0 +1,44 @@
+/* Has two subprocesses append interleaved records to one file
+   while a third reads another file that we are growing, then
+   checks that both files hold exactly what was written. */
+
+#include <syscall.h>
+#include "tests/filesys/extended/syn-append.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 3
+
+static char append_buf[APPEND_SIZE];
+static char grow_buf[GROW_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  size_t ofs;
+  int fd;
+
+  for (ofs = 0; ofs < APPEND_SIZE; ofs++)
+    append_buf[ofs] = record_byte (ofs / RECORD_SIZE);
+  for (ofs = 0; ofs < GROW_SIZE; ofs++)
+    grow_buf[ofs] = grow_byte (ofs);
+
+  CHECK (create (append_file, 0), "create \"%s\"", append_file);
+  CHECK (create (grow_file, 0), "create \"%s\"", grow_file);
+  CHECK ((fd = open (grow_file)) > 1, "open \"%s\"", grow_file);
+
+  exec_children ("child-syn-append", children, CHILD_CNT);
+
+  quiet = true;
+  for (ofs = 0; ofs < GROW_SIZE; ofs += GROW_CHUNK)
+    CHECK (write (fd, grow_buf + ofs, GROW_CHUNK) == GROW_CHUNK,
+           "write %d bytes at offset %zu in \"%s\"",
+           GROW_CHUNK, ofs, grow_file);
+  quiet = false;
+  close (fd);
+
+  wait_children (children, CHILD_CNT);
+  check_file (append_file, append_buf, APPEND_SIZE);
+  check_file (grow_file, grow_buf, GROW_SIZE);
+}
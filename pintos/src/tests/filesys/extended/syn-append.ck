@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-append) begin
+(syn-append) create "appendfile"
+(syn-append) create "growfile"
+(syn-append) open "growfile"
+(syn-append) exec child 1 of 3: "child-syn-append 0"
+(syn-append) exec child 2 of 3: "child-syn-append 1"
+(syn-append) exec child 3 of 3: "child-syn-append 2"
+(syn-append) wait for child 1 of 3 returned 0 (expected 0)
+(syn-append) wait for child 2 of 3 returned 1 (expected 1)
+(syn-append) wait for child 3 of 3 returned 2 (expected 2)
+(syn-append) open "appendfile" for verification
+(syn-append) verified contents of "appendfile"
+(syn-append) close "appendfile"
+(syn-append) open "growfile" for verification
+(syn-append) verified contents of "growfile"
+(syn-append) close "growfile"
+(syn-append) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_APPEND_H
+#define TESTS_FILESYS_EXTENDED_SYN_APPEND_H
+
+/* Two appenders each write RECORD_CNT records to APPEND_FILE,
+   taking turns by position: record slot I, of RECORD_SIZE bytes
+   that do not divide a sector, belongs to appender I % 2 and is
+   filled with record_byte (I). */
+#define RECORD_SIZE 100
+#define RECORD_CNT 64
+#define APPEND_SIZE (2 * RECORD_SIZE * RECORD_CNT)
+static const char append_file[] = "appendfile";
+
+/* The parent grows GROW_FILE in GROW_CHUNK-byte writes, each
+   spanning several sectors, while a reader follows it. */
+#define GROW_CHUNK 1000
+#define GROW_CNT 16
+#define GROW_SIZE (GROW_CHUNK * GROW_CNT)
+static const char grow_file[] = "growfile";
+
+/* Contents of record slot SLOT of APPEND_FILE. */
+static inline char
+record_byte (int slot)
+{
+  return 'A' + slot % 26;
+}
+
+/* Contents of byte OFS of GROW_FILE.  Never zero, so that a
+   byte read before it was written stands out. */
+static inline char
+grow_byte (int ofs)
+{
+  return 'a' + ofs / 7 % 26;
+}
+
+#endif /* tests/filesys/extended/syn-append.h */
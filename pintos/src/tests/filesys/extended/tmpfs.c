@@ -0,0 +1,57 @@
+/* Creates, reads back, lists and removes files and directories
+   under /tmp, the in-memory file system, and checks that the
+   mount point can be neither removed nor shadowed and does not
+   appear when the root directory is read. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[1500];
+static char readback[sizeof buf];
+
+void
+test_main (void) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  int fd;
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = 'a' + i % 26;
+
+  CHECK (mkdir ("/tmp/d"), "mkdir \"/tmp/d\"");
+  CHECK (create ("/tmp/d/f", 0), "create \"/tmp/d/f\"");
+  CHECK ((fd = open ("/tmp/d/f")) > 1, "open \"/tmp/d/f\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"/tmp/d/f\"");
+  CHECK (filesize (fd) == sizeof buf, "filesize \"/tmp/d/f\"");
+  CHECK (pread (fd, readback, sizeof readback, 0) == sizeof readback,
+         "read \"/tmp/d/f\"");
+  if (memcmp (readback, buf, sizeof buf))
+    fail ("data read back from \"/tmp/d/f\" differs");
+  close (fd);
+
+  CHECK ((fd = open ("/tmp/d")) > 1, "open \"/tmp/d\"");
+  CHECK (isdir (fd), "isdir \"/tmp/d\"");
+  CHECK (readdir (fd, name) && !strcmp (name, "f"), "readdir \"/tmp/d\"");
+  CHECK (!readdir (fd, name), "no more entries in \"/tmp/d\"");
+  close (fd);
+
+  CHECK (chdir ("/tmp/d"), "chdir \"/tmp/d\"");
+  CHECK ((fd = open ("f")) > 1, "open \"f\"");
+  close (fd);
+  CHECK (chdir ("../.."), "chdir \"../..\"");
+
+  CHECK (!mkdir ("/tmp"), "mkdir \"/tmp\" (must return false)");
+  CHECK (!remove ("/tmp"), "remove \"/tmp\" (must return false)");
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+  while (readdir (fd, name))
+    if (!strcmp (name, "tmp"))
+      fail ("\"tmp\" listed in \"/\"");
+  close (fd);
+
+  CHECK (remove ("/tmp/d/f"), "remove \"/tmp/d/f\"");
+  CHECK (remove ("/tmp/d"), "remove \"/tmp/d\"");
+  CHECK (open ("/tmp/d") == -1, "open \"/tmp/d\" (must return -1)");
+}
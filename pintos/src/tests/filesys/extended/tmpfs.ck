@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(tmpfs) begin
+(tmpfs) mkdir "/tmp/d"
+(tmpfs) create "/tmp/d/f"
+(tmpfs) open "/tmp/d/f"
+(tmpfs) write "/tmp/d/f"
+(tmpfs) filesize "/tmp/d/f"
+(tmpfs) read "/tmp/d/f"
+(tmpfs) open "/tmp/d"
+(tmpfs) isdir "/tmp/d"
+(tmpfs) readdir "/tmp/d"
+(tmpfs) no more entries in "/tmp/d"
+(tmpfs) chdir "/tmp/d"
+(tmpfs) open "f"
+(tmpfs) chdir "../.."
+(tmpfs) mkdir "/tmp" (must return false)
+(tmpfs) remove "/tmp" (must return false)
+(tmpfs) open "/"
+(tmpfs) remove "/tmp/d/f"
+(tmpfs) remove "/tmp/d"
+(tmpfs) open "/tmp/d" (must return -1)
+(tmpfs) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"child-trunc-race" => "tests/filesys/extended/child-trunc-race",
+		"racefile" => ["\0" x 8192]});
+pass;
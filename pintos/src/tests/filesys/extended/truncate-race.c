@@ -0,0 +1,37 @@
+/* Shrinks and regrows a file with ftruncate() while one
+   subprocess reads it and another overwrites it in place,
+   checking that neither sees bytes from a released sector. */
+
+#include <syscall.h>
+#include "tests/filesys/extended/truncate-race.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 2
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int fd, round;
+
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  exec_children ("child-trunc-race", children, CHILD_CNT);
+
+  quiet = true;
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      CHECK (ftruncate (fd, round % 2 ? 700 : 0),
+             "shrink \"%s\" in round %d", file_name, round);
+      CHECK (ftruncate (fd, FILE_SIZE),
+             "regrow \"%s\" in round %d", file_name, round);
+    }
+  quiet = false;
+
+  wait_children (children, CHILD_CNT);
+  CHECK (ftruncate (fd, 0), "ftruncate to 0 bytes");
+  CHECK (ftruncate (fd, FILE_SIZE), "ftruncate to %d bytes", FILE_SIZE);
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(truncate-race) begin
+(truncate-race) create "racefile"
+(truncate-race) open "racefile"
+(truncate-race) exec child 1 of 2: "child-trunc-race 0"
+(truncate-race) exec child 2 of 2: "child-trunc-race 1"
+(truncate-race) wait for child 1 of 2 returned 0 (expected 0)
+(truncate-race) wait for child 2 of 2 returned 1 (expected 1)
+(truncate-race) ftruncate to 0 bytes
+(truncate-race) ftruncate to 8192 bytes
+(truncate-race) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_EXTENDED_TRUNCATE_RACE_H
+#define TESTS_FILESYS_EXTENDED_TRUNCATE_RACE_H
+
+#define FILE_SIZE 8192
+#define ROUND_CNT 64
+static const char file_name[] = "racefile";
+
+#endif /* tests/filesys/extended/truncate-race.h */
@@ -0,0 +1,43 @@
+/* Reserves space with fallocate(), then shrinks and regrows a
+   file with ftruncate(), checking that the length follows and
+   that bytes past a truncation read back as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[2000];
+static char readback[sizeof buf];
+
+void
+test_main (void) 
+{
+  int fd;
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = 'A' + i % 26;
+
+  CHECK (create ("t", 0), "create \"t\"");
+  CHECK ((fd = open ("t")) > 1, "open \"t\"");
+  CHECK (fallocate (fd, 50000), "fallocate 50000 bytes");
+  CHECK (filesize (fd) == 0, "fallocate leaves filesize 0");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write %zu bytes",
+         sizeof buf);
+
+  CHECK (ftruncate (fd, 700), "ftruncate to 700 bytes");
+  CHECK (filesize (fd) == 700, "filesize is 700");
+  CHECK (ftruncate (fd, 1500), "ftruncate to 1500 bytes");
+  CHECK (filesize (fd) == 1500, "filesize is 1500");
+
+  memset (buf + 700, 0, sizeof buf - 700);
+  CHECK (pread (fd, readback, 1500, 0) == 1500, "read 1500 bytes");
+  if (memcmp (readback, buf, 1500))
+    fail ("bytes past the truncation point are not zero");
+
+  CHECK (ftruncate (fd, 0), "ftruncate to 0 bytes");
+  CHECK (filesize (fd) == 0, "filesize is 0");
+  CHECK (ftruncate (fd, 700), "ftruncate to 700 bytes");
+  close (fd);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(truncate) begin
+(truncate) create "t"
+(truncate) open "t"
+(truncate) fallocate 50000 bytes
+(truncate) fallocate leaves filesize 0
+(truncate) write 2000 bytes
+(truncate) ftruncate to 700 bytes
+(truncate) filesize is 700
+(truncate) ftruncate to 1500 bytes
+(truncate) filesize is 1500
+(truncate) read 1500 bytes
+(truncate) ftruncate to 0 bytes
+(truncate) filesize is 0
+(truncate) ftruncate to 700 bytes
+(truncate) end
+EOF
+pass;
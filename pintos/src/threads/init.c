@@ -34,6 +34,8 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -58,6 +60,12 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk: Size of RAM disk to create, in kB, or 0 for none. */
+static size_t ramdisk_kb;
+
+/* -trace: Trace block I/O from startup? */
+static bool trace_blocks;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -128,7 +136,11 @@ main (void)
 
 #ifdef FILESYS
   /* Initialize file system. */
+  if (trace_blocks && !block_trace_start ())
+    PANIC ("Out of memory for block I/O trace");
   ide_init ();
+  if (ramdisk_kb != 0)
+    ramdisk_create (ramdisk_kb);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -261,6 +273,10 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-trace"))
+        trace_blocks = true;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -329,6 +345,9 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"defrag", 1, fsutil_defrag},
+      {"trace-dump", 1, fsutil_trace_dump},
+      {"replay", 2, fsutil_replay},
 #endif
       {NULL, 0, NULL},
     };
@@ -375,6 +394,9 @@ usage (void)
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  defrag             Defragment the file system in the background.\n"
+          "  trace-dump         Write block I/O traced since -trace to scratch.\n"
+          "  replay BDEV        Replay trace from scratch on BDEV and time it.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
@@ -390,6 +412,9 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "  A list BDEV,BDEV,... for one of the above stripes it across them.\n"
+          "  -ramdisk=KB        Create RAM disk ram0 of KB kB, for use as a BDEV.\n"
+          "  -trace             Trace block I/O, for trace-dump.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
@@ -413,15 +438,18 @@ locate_block_devices (void)
 }
 
 /* Figures out what block device to use for the given ROLE: the
-   block device with the given NAME, if NAME is non-null,
-   otherwise the first block device in probe order of type
-   ROLE. */
+   block device with the given NAME, if NAME is non-null, a new
+   striped device over the block devices if NAME is a list of
+   them separated by commas, otherwise the first block device in
+   probe order of type ROLE. */
 static void
 locate_block_device (enum block_type role, const char *name)
 {
   struct block *block = NULL;
 
-  if (name != NULL)
+  if (name != NULL && strchr (name, ',') != NULL)
+    block = stripe_create (role, name);
+  else if (name != NULL)
     {
       block = block_get_by_name (name);
       if (block == NULL)
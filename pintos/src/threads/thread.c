@@ -169,6 +169,17 @@ thread_print_stats (void)
           idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Stores the statistics printed by thread_print_stats(). */
+void
+thread_get_stats (long long *idle, long long *kernel, long long *user) 
+{
+  enum intr_level old_level = intr_disable ();
+  *idle = idle_ticks;
+  *kernel = kernel_ticks;
+  *user = user_ticks;
+  intr_set_level (old_level);
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -704,6 +715,10 @@ init_thread (struct thread *t, const char *name, int priority)
   else
     thread_update_priority (t, NULL);
 
+  t->io_class = BLOCK_IO_DEMAND;
+  t->io_priority = -1;
+  t->block_dispatcher = false;
+
   list_init (&(t->locks_held));
   list_init (&(t->open_files));
   list_init (&(t->mmapped_files));
@@ -94,6 +94,10 @@ struct thread
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
     int original_priority;              /* Original priority before donation */
+    enum block_io_class io_class;       /* Class of block I/O it submits. */
+    int io_priority;                    /* Priority of block I/O it
+                                           submits, or -1 for its own. */
+    bool block_dispatcher;              /* Serves a block device queue? */
     struct list_elem allelem;           /* List element for all threads list.*/
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
@@ -129,6 +133,7 @@ void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_get_stats (long long *idle, long long *kernel, long long *user);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
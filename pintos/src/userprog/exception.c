@@ -75,6 +75,13 @@ exception_print_stats (void)
   printf ("Exception: %lld page faults\n", page_fault_cnt);
 }
 
+/* Returns the number of page faults so far. */
+long long
+exception_page_fault_cnt (void) 
+{
+  return page_fault_cnt;
+}
+
 /* Handler for an exception (probably) caused by a user process. */
 static void
 kill (struct intr_frame *f) 
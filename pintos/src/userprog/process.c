@@ -717,6 +717,7 @@ wrap_file (void *file_or_dir, bool is_dir)
     thread_exit ();
   fw->is_dir = is_dir;
   fw->file_or_dir = file_or_dir;
+  fw->flags = 0;
   fw->fd = allocate_fd ();
   return fw;
 }
@@ -727,16 +728,15 @@ struct file_wrapper *
 lookup_fd ( fd_t fd)
 {
   struct thread *cur = thread_current ();
-  struct file_wrapper *fw = NULL;
   struct list_elem *e;
 
   for (e = list_begin (&cur->open_files); e != list_end (&cur->open_files);e = list_next (e))
   {
-    fw = list_entry (e, struct file_wrapper, elem);
+    struct file_wrapper *fw = list_entry (e, struct file_wrapper, elem);
     if (fw->fd == fd)
-      break;
+      return fw;
   }
-  return fw;
+  return NULL;
 }
 
 /* Returns a fd to use for a new open file. */
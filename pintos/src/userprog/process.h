@@ -29,11 +29,17 @@ struct process
     struct list_elem elem;
 };
 
+/* Flags for open_flags().
+   Must match lib/user/syscall.h. */
+#define O_SYNC 1        /* Every write is followed by fsync. */
+#define O_DSYNC 2       /* Every write is followed by fdatasync. */
+
 struct file_wrapper
 {
     fd_t fd;
     void *file_or_dir;
     bool is_dir;
+    int flags; // O_SYNC, O_DSYNC
     struct list_elem elem;
 };
 
@@ -17,6 +17,7 @@
 #include "vm/page.h"
 #include "vm/frame.h"
 #include <hash.h>
+#include <limits.h>
 #include <string.h>
 #include "filesys/inode.h"
 
@@ -25,6 +26,9 @@ static void verify_uaddr ( void *uaddr);
 static void check_buffer_uaddr ( void *buf, int size);
 static void pin_buffer (void *buf, int size);
 static void unpin_buffer (void *buf, int size);
+static void console_read (char *buf, int size);
+static void console_write (const char *buf, int size);
+static void sync_written (uint32_t fd);
 
 // Prototypes for each system call called by the handler.
 void syscall_halt (void);
@@ -49,6 +53,25 @@ void syscall_mkdir (struct intr_frame *f, uint32_t dir_name);
 void syscall_readdir (struct intr_frame *f, uint32_t fd, uint32_t name);
 void syscall_isdir (struct intr_frame *f, uint32_t fd);
 void syscall_inumber (struct intr_frame *f, uint32_t fd);
+void syscall_getdents (struct intr_frame *f, uint32_t fd, uint32_t ents,
+                       uint32_t cnt);
+void syscall_stat (struct intr_frame *f, uint32_t file_name, uint32_t st);
+void syscall_fstat (struct intr_frame *f, uint32_t fd, uint32_t st);
+void syscall_pread (struct intr_frame *f, uint32_t fd, uint32_t buffer,
+                    uint32_t length, uint32_t offset);
+void syscall_pwrite (struct intr_frame *f, uint32_t fd, uint32_t buffer,
+                     uint32_t length, uint32_t offset);
+void syscall_readv (struct intr_frame *f, uint32_t fd, uint32_t iov,
+                    uint32_t iovcnt);
+void syscall_writev (struct intr_frame *f, uint32_t fd, uint32_t iov,
+                     uint32_t iovcnt);
+void syscall_copy_file_range (struct intr_frame *f, uint32_t fd_in,
+                              uint32_t fd_out, uint32_t length);
+void syscall_fsync (struct intr_frame *f, uint32_t fd, bool data_only);
+void syscall_open_flags (struct intr_frame *f, uint32_t file_name,
+                         uint32_t flags);
+void syscall_fallocate (struct intr_frame *f, uint32_t fd, uint32_t length);
+void syscall_ftruncate (struct intr_frame *f, uint32_t fd, uint32_t length);
 
 
 
@@ -70,19 +93,33 @@ syscall_handler (struct intr_frame *f)
   uint32_t arg1 = 0; //Initialized to prevent compiler warnings
   uint32_t arg2 = 0;
   uint32_t arg3 = 0;
+  uint32_t arg4 = 0;
 
 
   // Initializing only the arguments that are needed
   switch (syscall_number)
   {
+    case SYS_PREAD:
+    case SYS_PWRITE:
+      verify_uaddr (f->esp + 16);
+      arg4 = *(uint32_t *) (f->esp + 16);
     case SYS_READ:
     case SYS_WRITE:
+    case SYS_GETDENTS:
+    case SYS_READV:
+    case SYS_WRITEV:
+    case SYS_COPY_FILE_RANGE:
       verify_uaddr (f->esp + 12);
       arg3 = *(uint32_t *) (f->esp + 12);
     case SYS_CREATE:
     case SYS_SEEK:
     case SYS_MMAP:
     case SYS_READDIR:
+    case SYS_STAT:
+    case SYS_FSTAT:
+    case SYS_OPEN_FLAGS:
+    case SYS_FALLOCATE:
+    case SYS_FTRUNCATE:
       verify_uaddr (f->esp + 8);
       arg2 = *(uint32_t *) (f->esp + 8);
     case SYS_EXIT:
@@ -98,6 +135,8 @@ syscall_handler (struct intr_frame *f)
     case SYS_MKDIR:
     case SYS_ISDIR:
     case SYS_INUMBER:
+    case SYS_FSYNC:
+    case SYS_FDATASYNC:
       verify_uaddr (f->esp + 4);
       arg1 = *(uint32_t *) (f->esp + 4);
     case SYS_HALT:
@@ -166,6 +205,45 @@ syscall_handler (struct intr_frame *f)
       case SYS_INUMBER:
         syscall_inumber (f, arg1);
         break;
+      case SYS_GETDENTS:
+        syscall_getdents (f, arg1, arg2, arg3);
+        break;
+      case SYS_STAT:
+        syscall_stat (f, arg1, arg2);
+        break;
+      case SYS_FSTAT:
+        syscall_fstat (f, arg1, arg2);
+        break;
+      case SYS_PREAD:
+        syscall_pread (f, arg1, arg2, arg3, arg4);
+        break;
+      case SYS_PWRITE:
+        syscall_pwrite (f, arg1, arg2, arg3, arg4);
+        break;
+      case SYS_READV:
+        syscall_readv (f, arg1, arg2, arg3);
+        break;
+      case SYS_WRITEV:
+        syscall_writev (f, arg1, arg2, arg3);
+        break;
+      case SYS_COPY_FILE_RANGE:
+        syscall_copy_file_range (f, arg1, arg2, arg3);
+        break;
+      case SYS_FSYNC:
+        syscall_fsync (f, arg1, false);
+        break;
+      case SYS_FDATASYNC:
+        syscall_fsync (f, arg1, true);
+        break;
+      case SYS_OPEN_FLAGS:
+        syscall_open_flags (f, arg1, arg2);
+        break;
+      case SYS_FALLOCATE:
+        syscall_fallocate (f, arg1, arg2);
+        break;
+      case SYS_FTRUNCATE:
+        syscall_ftruncate (f, arg1, arg2);
+        break;
       default:
         printf ("system call!\n");
         thread_exit ();
@@ -221,9 +299,21 @@ void syscall_remove (struct intr_frame *f, uint32_t file_name)
 }
 
 void syscall_open (struct intr_frame *f, uint32_t file_name) 
+{
+  syscall_open_flags (f, file_name, 0);
+}
+
+void syscall_open_flags (struct intr_frame *f, uint32_t file_name,
+                         uint32_t flags) 
 {
   bool is_dir;
 
+  if ((flags & ~(O_SYNC | O_DSYNC)) != 0)
+  {
+    f->eax = -1;
+    return;
+  }
+
   verify_uaddr ((char *) file_name);
   pin_buffer ((char *) file_name, strlen ((char *) file_name));
   void *file_or_dir = filesys_open ( (char *) file_name, &is_dir);
@@ -231,6 +321,7 @@ void syscall_open (struct intr_frame *f, uint32_t file_name)
     f->eax = -1;
   } else {
     struct file_wrapper *fw = wrap_file (file_or_dir, is_dir); 
+    fw->flags = flags;
     list_push_back (&thread_current ()->open_files, &fw->elem);   
     f->eax = fw->fd;
   }
@@ -261,11 +352,8 @@ void syscall_read (struct intr_frame *f, uint32_t fd, uint32_t buffer,
   check_buffer_uaddr (buf, size);
   
   if (fd  == 0) { //Read from Keyboard
-    int count = 0;
-    while (size - count > 0) {
-      buf[count] = input_getc ();
-      count ++;
-    }
+    console_read (buf, size);
+    f->eax = size;
   } else {
     struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
     if (fw == NULL || fw->is_dir) {
@@ -284,14 +372,8 @@ void syscall_write (struct intr_frame *f, uint32_t fd, uint32_t buffer,
   char *buf = (void *) buffer;
   int size = length;
   check_buffer_uaddr (buf, size);
-  int BUF_CHUNK = 200;
   if (fd == 1) {  //Write to console 
-    while (size > BUF_CHUNK) {
-      putbuf(buf, BUF_CHUNK);
-      size -= BUF_CHUNK;
-    }
-    putbuf(buf, size);
-    size = length;
+    console_write (buf, size);
     f->eax = size;
   } else {
     struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
@@ -301,6 +383,7 @@ void syscall_write (struct intr_frame *f, uint32_t fd, uint32_t buffer,
       pin_buffer (buf, size);
       f->eax = file_write ((struct file *)fw->file_or_dir, buf, size);
       unpin_buffer (buf, size);
+      sync_written (fd);
     }
   }
 }
@@ -475,6 +558,358 @@ syscall_inumber (struct intr_frame *f, uint32_t fd)
     f->eax = -1;
 }
 
+void 
+syscall_getdents (struct intr_frame *f, uint32_t fd, uint32_t ents_,
+                  uint32_t cnt)
+{
+  struct dirent *ents = (struct dirent *) ents_;
+  int size = cnt * sizeof *ents;
+
+  struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
+  if (fw == NULL || !fw->is_dir || cnt > INT_MAX / sizeof *ents) 
+  {
+    f->eax = -1;
+    return;
+  }
+  if (cnt == 0)
+  {
+    f->eax = 0;
+    return;
+  }
+
+  check_buffer_uaddr (ents, size);
+  pin_buffer (ents, size);
+  f->eax = dir_readdir_many ((struct dir *)fw->file_or_dir, ents, cnt);
+  unpin_buffer (ents, size);
+}
+
+/* Copies ST out to the user buffer at ST_. */
+static void
+copy_out_stat (uint32_t st_, const struct stat *st)
+{
+  struct stat *user_st = (struct stat *) st_;
+
+  check_buffer_uaddr (user_st, sizeof *user_st);
+  pin_buffer (user_st, sizeof *user_st);
+  memcpy (user_st, st, sizeof *user_st);
+  unpin_buffer (user_st, sizeof *user_st);
+}
+
+void 
+syscall_stat (struct intr_frame *f, uint32_t file_name_, uint32_t st_)
+{
+  char *file_name = (char *) file_name_;
+  struct stat st;
+
+  verify_uaddr (file_name);
+  pin_buffer (file_name, strlen (file_name));
+  f->eax = filesys_stat (file_name, &st);
+  unpin_buffer (file_name, strlen (file_name));
+
+  if (f->eax)
+    copy_out_stat (st_, &st);
+}
+
+void 
+syscall_fstat (struct intr_frame *f, uint32_t fd, uint32_t st_)
+{
+  struct stat st;
+
+  struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
+  if (fw == NULL) 
+  {
+    f->eax = false;
+    return;
+  }
+
+  if (fw->is_dir)
+    inode_stat (dir_get_inode ((struct dir *) fw->file_or_dir), &st);
+  else
+    inode_stat (file_get_inode ((struct file *) fw->file_or_dir), &st);
+  copy_out_stat (st_, &st);
+  f->eax = true;
+}
+
+/* Returns the open file for FD, or a null pointer if FD is not
+   an open file.  The console and directories do not count. */
+static struct file *
+lookup_file (uint32_t fd)
+{
+  struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
+  if (fw == NULL || fw->is_dir)
+    return NULL;
+  return (struct file *) fw->file_or_dir;
+}
+
+void
+syscall_pread (struct intr_frame *f, uint32_t fd, uint32_t buffer,
+               uint32_t length, uint32_t offset)
+{
+  char *buf = (void *) buffer;
+  int size = length;
+  struct file *file = lookup_file (fd);
+
+  if (file == NULL || size < 0 || (off_t) offset < 0)
+  {
+    f->eax = -1;
+    return;
+  }
+  if (size == 0)
+  {
+    f->eax = 0;
+    return;
+  }
+  check_buffer_uaddr (buf, size);
+  pin_buffer (buf, size);
+  f->eax = file_read_at (file, buf, size, offset);
+  unpin_buffer (buf, size);
+}
+
+void
+syscall_pwrite (struct intr_frame *f, uint32_t fd, uint32_t buffer,
+                uint32_t length, uint32_t offset)
+{
+  char *buf = (void *) buffer;
+  int size = length;
+  struct file *file = lookup_file (fd);
+
+  if (file == NULL || size < 0 || (off_t) offset < 0)
+  {
+    f->eax = -1;
+    return;
+  }
+  if (size == 0)
+  {
+    f->eax = 0;
+    return;
+  }
+  check_buffer_uaddr (buf, size);
+  pin_buffer (buf, size);
+  f->eax = file_write_at (file, buf, size, offset);
+  unpin_buffer (buf, size);
+  sync_written (fd);
+}
+
+/* Copies IOVCNT iovecs from user address IOV_ into a new kernel
+   array, then verifies and pins every buffer they describe, so
+   that the transfer itself needs no further checks.  Returns
+   the array, which the caller must release with release_iov(),
+   and stores the total byte count into *TOTAL.  Returns a null
+   pointer if IOVCNT is out of range or the total overflows. */
+static struct iovec *
+acquire_iov (uint32_t iov_, uint32_t iovcnt, int *total)
+{
+  const struct iovec *user_iov = (const struct iovec *) iov_;
+  struct iovec *iov;
+  size_t sum = 0;
+  uint32_t i;
+
+  if (iovcnt == 0 || iovcnt > IOV_MAX)
+    return NULL;
+
+  check_buffer_uaddr ((void *) user_iov, iovcnt * sizeof *user_iov);
+  iov = malloc (iovcnt * sizeof *iov);
+  if (iov == NULL)
+    return NULL;
+  pin_buffer ((void *) user_iov, iovcnt * sizeof *user_iov);
+  memcpy (iov, user_iov, iovcnt * sizeof *iov);
+  unpin_buffer ((void *) user_iov, iovcnt * sizeof *user_iov);
+
+  for (i = 0; i < iovcnt; i++)
+  {
+    if (iov[i].iov_len > INT_MAX - sum)
+    {
+      free (iov);
+      return NULL;
+    }
+    sum += iov[i].iov_len;
+    if (iov[i].iov_len > 0)
+      check_buffer_uaddr (iov[i].iov_base, iov[i].iov_len);
+  }
+  for (i = 0; i < iovcnt; i++)
+    if (iov[i].iov_len > 0)
+      pin_buffer (iov[i].iov_base, iov[i].iov_len);
+
+  *total = sum;
+  return iov;
+}
+
+/* Unpins the buffers described by IOV and frees it. */
+static void
+release_iov (struct iovec *iov, uint32_t iovcnt)
+{
+  uint32_t i;
+
+  for (i = 0; i < iovcnt; i++)
+    if (iov[i].iov_len > 0)
+      unpin_buffer (iov[i].iov_base, iov[i].iov_len);
+  free (iov);
+}
+
+void
+syscall_readv (struct intr_frame *f, uint32_t fd, uint32_t iov_,
+               uint32_t iovcnt)
+{
+  struct file *file = NULL;
+  struct iovec *iov;
+  int total;
+  uint32_t i;
+
+  if (fd != 0 && (file = lookup_file (fd)) == NULL)
+  {
+    f->eax = -1;
+    return;
+  }
+  iov = acquire_iov (iov_, iovcnt, &total);
+  if (iov == NULL)
+  {
+    f->eax = -1;
+    return;
+  }
+
+  total = 0;
+  for (i = 0; i < iovcnt; i++)
+  {
+    int size = iov[i].iov_len;
+    int bytes_read;
+
+    if (file == NULL)
+    {
+      console_read (iov[i].iov_base, size);
+      bytes_read = size;
+    }
+    else
+      bytes_read = file_read (file, iov[i].iov_base, size);
+    total += bytes_read;
+    if (bytes_read < size)
+      break;
+  }
+  release_iov (iov, iovcnt);
+  f->eax = total;
+}
+
+void
+syscall_writev (struct intr_frame *f, uint32_t fd, uint32_t iov_,
+                uint32_t iovcnt)
+{
+  struct file *file = NULL;
+  struct iovec *iov;
+  int total;
+  uint32_t i;
+
+  if (fd != 1 && (file = lookup_file (fd)) == NULL)
+  {
+    f->eax = -1;
+    return;
+  }
+  iov = acquire_iov (iov_, iovcnt, &total);
+  if (iov == NULL)
+  {
+    f->eax = -1;
+    return;
+  }
+
+  if (file == NULL)
+  {
+    for (i = 0; i < iovcnt; i++)
+      console_write (iov[i].iov_base, iov[i].iov_len);
+  }
+  else
+  {
+    total = 0;
+    for (i = 0; i < iovcnt; i++)
+    {
+      int size = iov[i].iov_len;
+      int bytes_written = file_write (file, iov[i].iov_base, size);
+
+      total += bytes_written;
+      if (bytes_written < size)
+        break;
+    }
+    sync_written (fd);
+  }
+  release_iov (iov, iovcnt);
+  f->eax = total;
+}
+
+void
+syscall_copy_file_range (struct intr_frame *f, uint32_t fd_in,
+                         uint32_t fd_out, uint32_t length)
+{
+  struct file *in = lookup_file (fd_in);
+  struct file *out = lookup_file (fd_out);
+
+  if (in == NULL || out == NULL || (int) length < 0
+      || (off_t) length > INT_MAX - file_tell (out))
+  {
+    f->eax = -1;
+    return;
+  }
+  f->eax = file_copy (out, in, length);
+  sync_written (fd_out);
+}
+
+/* Writes FD's dirty blocks to disk.  With DATA_ONLY, the inode
+   and free map are only written if the file's length changed. */
+void
+syscall_fsync (struct intr_frame *f, uint32_t fd, bool data_only)
+{
+  struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
+  struct inode *inode;
+
+  if (fw == NULL)
+  {
+    f->eax = false;
+    return;
+  }
+  if (fw->is_dir)
+    inode = dir_get_inode ((struct dir *) fw->file_or_dir);
+  else
+    inode = file_get_inode ((struct file *) fw->file_or_dir);
+  inode_sync (inode, data_only);
+  f->eax = true;
+}
+
+void
+syscall_fallocate (struct intr_frame *f, uint32_t fd, uint32_t length)
+{
+  struct file *file = lookup_file (fd);
+
+  if (file == NULL || (off_t) length < 0)
+    f->eax = false;
+  else
+    f->eax = file_allocate (file, length);
+}
+
+void
+syscall_ftruncate (struct intr_frame *f, uint32_t fd, uint32_t length)
+{
+  struct file *file = lookup_file (fd);
+
+  if (file == NULL || (off_t) length < 0)
+    f->eax = false;
+  else
+  {
+    f->eax = file_truncate (file, length);
+    sync_written (fd);
+  }
+}
+
+/* Syncs FD after a write if it was opened with O_SYNC or
+   O_DSYNC. */
+static void
+sync_written (uint32_t fd)
+{
+  struct file_wrapper *fw = lookup_fd ( (fd_t) fd);
+
+  if (fw == NULL || fw->is_dir)
+    return;
+  if (fw->flags & O_SYNC)
+    inode_sync (file_get_inode ((struct file *) fw->file_or_dir), false);
+  else if (fw->flags & O_DSYNC)
+    inode_sync (file_get_inode ((struct file *) fw->file_or_dir), true);
+}
+
 
 static void
 verify_uaddr (void *uaddr)
@@ -522,3 +957,28 @@ unpin_buffer (void *buf, int size)
     frame_unpin (buf + i*PGSIZE);
   frame_unpin (buf + size - 1);
 }
+
+/* Reads SIZE keystrokes into BUF. */
+static void
+console_read (char *buf, int size)
+{
+  int count;
+
+  for (count = 0; count < size; count++)
+    buf[count] = input_getc ();
+}
+
+/* Writes SIZE bytes from BUF to the console, in chunks small
+   enough not to interleave badly with other processes' output. */
+static void
+console_write (const char *buf, int size)
+{
+  int BUF_CHUNK = 200;
+
+  while (size > BUF_CHUNK) {
+    putbuf (buf, BUF_CHUNK);
+    buf += BUF_CHUNK;
+    size -= BUF_CHUNK;
+  }
+  putbuf (buf, size);
+}
@@ -1,6 +1,19 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stddef.h>
+
+/* One buffer of a readv() or writev() request.
+   Must match struct iovec in lib/user/syscall.h. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Number of bytes in buffer. */
+  };
+
+/* Maximum number of buffers in a readv() or writev() request. */
+#define IOV_MAX 1024
+
 void syscall_init (void);
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,887 @@
+/* pintos-mkfs: builds, dumps, and reports on Pintos file system
+   images from the host.
+
+   Building an image writes the on-disk format directly: the free
+   map, inodes, index blocks, and directories.  Each file's
+   inode, index blocks, and data are laid out next to each other,
+   and a directory's children follow the directory itself, so a
+   freshly built image has no fragmentation at all.  The output
+   is the raw contents of a file system partition, suitable for
+   "pintos --filesys=IMAGE", so tests and benchmarks can boot a
+   populated disk without extracting a scratch archive first.
+
+   The structures below must match filesys/inode.c,
+   filesys/directory.c, and filesys/free-map.c.  As in the
+   kernel, integers are stored in the host's byte order, which
+   must be little-endian. */
+
+#define _GNU_SOURCE 1
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define BLOCK_SECTOR_SIZE 512
+#define FREE_MAP_SECTOR 0
+#define ROOT_DIR_SECTOR 1
+#define HOT_LIST_SECTOR 2
+#undef NAME_MAX
+#define NAME_MAX 14
+
+#define INODE_MAGIC 0x494e4f44
+#define NUM_DIRECT_BLOCKS 12
+#define BLOCKS_PER_INDIRECT (BLOCK_SECTOR_SIZE / 4)
+#define DOUBLY_INDIRECT_START (NUM_DIRECT_BLOCKS + BLOCKS_PER_INDIRECT)
+#define MAX_SECTORS (DOUBLY_INDIRECT_START \
+                     + BLOCKS_PER_INDIRECT * BLOCKS_PER_INDIRECT)
+
+/* Entries the root directory has room for, as in do_format(). */
+#define ROOT_DIR_ENTRIES 16
+
+#define DIV_ROUND_UP(X, STEP) (((X) + (STEP) - 1) / (STEP))
+
+typedef uint32_t block_sector_t;
+
+/* On-disk inode.
+   Must match struct inode_disk in filesys/inode.c. */
+struct inode_disk
+  {
+    int32_t length;                     /* File size in bytes. */
+    uint32_t sector_cnt;                /* Data sectors allocated. */
+    block_sector_t direct_blocks[NUM_DIRECT_BLOCKS];
+    block_sector_t indirect_block;
+    block_sector_t doubly_indirect_block;
+    uint32_t is_dir;                    /* Nonzero for a directory. */
+    uint32_t magic;                     /* Magic number. */
+    uint32_t unused[110];               /* Not used. */
+  };
+
+/* Directory entry.
+   Must match struct dir_entry in filesys/directory.c. */
+struct dir_entry
+  {
+    block_sector_t inode_sector;        /* Sector number of header. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    bool in_use;                        /* In use or free? */
+    bool is_dir;                        /* Is the entry a directory? */
+  };
+
+/* A file or directory to be placed in the image. */
+struct node
+  {
+    char name[NAME_MAX + 1];            /* Name within parent. */
+    const char *host_path;              /* Contents, or NULL. */
+    bool is_dir;                        /* Directory? */
+    off_t length;                       /* Length of host file. */
+    block_sector_t sector;              /* Inode sector in image. */
+    struct node *children;              /* First child. */
+    struct node *next;                  /* Next sibling. */
+  };
+
+static uint8_t *image;                  /* Image contents. */
+static size_t image_sectors;            /* Image size in sectors. */
+
+static uint8_t *free_map;               /* Bitmap of used sectors. */
+static size_t free_map_bytes;           /* As in bitmap_file_size(). */
+static block_sector_t next_sector;      /* Next sector to allocate. */
+static size_t built_files, built_dirs;  /* Inodes written so far. */
+
+static void
+fail (const char *msg, ...)
+     __attribute__ ((noreturn))
+     __attribute__ ((format (printf, 1, 2)));
+
+/* Prints MSG, formatting as with printf(),
+   plus an error message based on errno if nonzero,
+   and exits. */
+static void
+fail (const char *msg, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkfs: ");
+  va_start (args, msg);
+  vfprintf (stderr, msg, args);
+  va_end (args);
+
+  if (errno != 0)
+    fprintf (stderr, ": %s", strerror (errno));
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+static void *
+xcalloc (size_t cnt, size_t size)
+{
+  void *p = calloc (cnt, size);
+  if (p == NULL)
+    fail ("out of memory");
+  return p;
+}
+
+/* Returns the contents of SECTOR in the image. */
+static uint8_t *
+sector_ptr (block_sector_t sector)
+{
+  return image + (size_t) sector * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns index block SECTOR as an array of sector numbers. */
+static block_sector_t *
+index_table (block_sector_t sector)
+{
+  return (block_sector_t *) sector_ptr (sector);
+}
+
+static bool
+bit_test (const uint8_t *bits, size_t idx)
+{
+  return (bits[idx / 8] >> (idx % 8)) & 1;
+}
+
+/* The kernel's bitmap is an array of 32-bit little-endian words,
+   so bit IDX lives in bit IDX % 8 of byte IDX / 8. */
+static void
+bit_mark (uint8_t *bits, size_t idx)
+{
+  bits[idx / 8] |= 1 << (idx % 8);
+}
+
+/* Allocates CNT consecutive sectors and returns the first. */
+static block_sector_t
+allocate (size_t cnt)
+{
+  block_sector_t start = next_sector;
+  size_t i;
+
+  if (cnt > image_sectors - next_sector)
+    {
+      errno = 0;
+      fail ("image is full (%zu sectors)", image_sectors);
+    }
+  for (i = 0; i < cnt; i++)
+    bit_mark (free_map, start + i);
+  next_sector += cnt;
+  return start;
+}
+
+/* Returns the number of index blocks a file of CNT data sectors
+   needs. */
+static size_t
+index_block_cnt (size_t cnt)
+{
+  size_t n = 0;
+
+  if (cnt > NUM_DIRECT_BLOCKS)
+    n++;
+  if (cnt > DOUBLY_INDIRECT_START)
+    n += 1 + DIV_ROUND_UP (cnt - DOUBLY_INDIRECT_START, BLOCKS_PER_INDIRECT);
+  return n;
+}
+
+/* Writes an inode for LENGTH bytes at SECTOR, followed by its
+   index blocks and then its data sectors, and returns the first
+   data sector.  The data sectors are contiguous. */
+static block_sector_t
+build_inode (block_sector_t sector, off_t length, bool is_dir)
+{
+  struct inode_disk *d = (struct inode_disk *) sector_ptr (sector);
+  size_t cnt = DIV_ROUND_UP (length, BLOCK_SECTOR_SIZE);
+  block_sector_t next_index, data;
+  size_t i;
+
+  errno = 0;
+  if (cnt > MAX_SECTORS)
+    fail ("%lld bytes is too large for a Pintos file", (long long) length);
+
+  next_index = allocate (index_block_cnt (cnt));
+  data = allocate (cnt);
+
+  d->length = length;
+  d->sector_cnt = cnt;
+  d->is_dir = is_dir;
+  d->magic = INODE_MAGIC;
+  for (i = 0; i < cnt; i++)
+    {
+      block_sector_t *slot;
+
+      if (i < NUM_DIRECT_BLOCKS)
+        slot = &d->direct_blocks[i];
+      else if (i < DOUBLY_INDIRECT_START)
+        {
+          if (d->indirect_block == 0)
+            d->indirect_block = next_index++;
+          slot = index_table (d->indirect_block) + (i - NUM_DIRECT_BLOCKS);
+        }
+      else
+        {
+          size_t j = i - DOUBLY_INDIRECT_START;
+          block_sector_t *dbl;
+
+          if (d->doubly_indirect_block == 0)
+            d->doubly_indirect_block = next_index++;
+          dbl = index_table (d->doubly_indirect_block);
+          if (dbl[j / BLOCKS_PER_INDIRECT] == 0)
+            dbl[j / BLOCKS_PER_INDIRECT] = next_index++;
+          slot = index_table (dbl[j / BLOCKS_PER_INDIRECT])
+                 + j % BLOCKS_PER_INDIRECT;
+        }
+      *slot = data + i;
+    }
+  return data;
+}
+
+/* Copies LENGTH bytes of host file PATH into the image starting
+   at sector DATA. */
+static void
+copy_file (const char *path, off_t length, block_sector_t data)
+{
+  FILE *f = fopen (path, "rb");
+
+  if (f == NULL)
+    fail ("%s: open", path);
+  if (fread (sector_ptr (data), 1, length, f) != (size_t) length)
+    fail ("%s: read", path);
+  fclose (f);
+}
+
+/* Stores an entry for NAME at slot IDX of the directory whose
+   contiguous data starts at sector DATA. */
+static void
+put_entry (block_sector_t data, size_t idx, const char *name,
+           block_sector_t sector, bool is_dir)
+{
+  struct dir_entry *e = (struct dir_entry *) sector_ptr (data) + idx;
+
+  e->inode_sector = sector;
+  strcpy (e->name, name);
+  e->in_use = true;
+  e->is_dir = is_dir;
+}
+
+/* Writes NODE, whose inode goes in NODE->sector, and everything
+   below it into the image.  PARENT is the sector of the parent
+   directory's inode. */
+static void
+build_node (struct node *node, block_sector_t parent)
+{
+  if (node->is_dir)
+    {
+      struct node *c;
+      size_t entry_cnt = 0;
+      block_sector_t data;
+
+      built_dirs++;
+      for (c = node->children; c != NULL; c = c->next)
+        entry_cnt++;
+      if (node->sector == ROOT_DIR_SECTOR && entry_cnt < ROOT_DIR_ENTRIES)
+        entry_cnt = ROOT_DIR_ENTRIES;
+      entry_cnt += 2;
+
+      data = build_inode (node->sector,
+                          entry_cnt * sizeof (struct dir_entry), true);
+      put_entry (data, 0, ".", node->sector, true);
+      put_entry (data, 1, "..", parent, true);
+      entry_cnt = 2;
+      for (c = node->children; c != NULL; c = c->next)
+        {
+          c->sector = allocate (1);
+          build_node (c, node->sector);
+          put_entry (data, entry_cnt++, c->name, c->sector, c->is_dir);
+        }
+    }
+  else
+    {
+      block_sector_t data = build_inode (node->sector, node->length, false);
+      built_files++;
+      copy_file (node->host_path, node->length, data);
+    }
+}
+
+/* Returns a new node named NAME. */
+static struct node *
+new_node (const char *name, bool is_dir)
+{
+  struct node *node = xcalloc (1, sizeof *node);
+
+  errno = 0;
+  if (strlen (name) > NAME_MAX)
+    fail ("%s: name longer than %d characters", name, NAME_MAX);
+  if (name[0] == '\0' || !strcmp (name, ".") || !strcmp (name, ".."))
+    fail ("\"%s\": invalid file name", name);
+  strcpy (node->name, name);
+  node->is_dir = is_dir;
+  return node;
+}
+
+/* Returns DIR's child named NAME, or a null pointer. */
+static struct node *
+find_child (struct node *dir, const char *name)
+{
+  struct node *c;
+
+  for (c = dir->children; c != NULL; c = c->next)
+    if (!strcmp (c->name, name))
+      return c;
+  return NULL;
+}
+
+/* Appends CHILD to DIR's children. */
+static void
+add_child (struct node *dir, struct node *child)
+{
+  struct node **p;
+
+  errno = 0;
+  if (find_child (dir, child->name) != NULL)
+    fail ("%s: duplicate name", child->name);
+  for (p = &dir->children; *p != NULL; p = &(*p)->next)
+    continue;
+  *p = child;
+}
+
+static void add_host_tree (struct node *dir, const char *path,
+                           const char *name);
+
+/* Adds the entries of host directory PATH to DIR, in name order
+   so that images are reproducible. */
+static void
+add_host_dir (struct node *dir, const char *path)
+{
+  struct dirent **names;
+  int cnt, i;
+
+  cnt = scandir (path, &names, NULL, alphasort);
+  if (cnt < 0)
+    fail ("%s: scandir", path);
+  for (i = 0; i < cnt; i++)
+    {
+      const char *name = names[i]->d_name;
+      if (strcmp (name, ".") && strcmp (name, ".."))
+        {
+          char *child_path;
+          if (asprintf (&child_path, "%s/%s", path, name) < 0)
+            fail ("out of memory");
+          add_host_tree (dir, child_path, name);
+        }
+      free (names[i]);
+    }
+  free (names);
+}
+
+/* Adds host file or directory PATH to DIR under NAME. */
+static void
+add_host_tree (struct node *dir, const char *path, const char *name)
+{
+  struct stat st;
+  struct node *node;
+
+  if (stat (path, &st) < 0)
+    fail ("%s: stat", path);
+  if (S_ISDIR (st.st_mode))
+    {
+      node = find_child (dir, name);
+      if (node == NULL || !node->is_dir)
+        {
+          node = new_node (name, true);
+          add_child (dir, node);
+        }
+      add_host_dir (node, path);
+    }
+  else if (S_ISREG (st.st_mode))
+    {
+      node = new_node (name, false);
+      node->host_path = path;
+      node->length = st.st_size;
+      add_child (dir, node);
+    }
+  else
+    {
+      errno = 0;
+      fail ("%s: not a regular file or directory", path);
+    }
+}
+
+/* Adds ARG, which is HOST-PATH or HOST-PATH=PINTOS-PATH, to the
+   tree under ROOT.  Directories along PINTOS-PATH are created
+   as needed.  Without a PINTOS-PATH the file goes in the root
+   directory under its host base name. */
+static void
+add_arg (struct node *root, char *arg)
+{
+  char *host_path = arg;
+  char *pintos_path = strchr (arg, '=');
+  struct node *dir = root;
+  char *name, *next, *save_ptr;
+
+  if (pintos_path != NULL)
+    *pintos_path++ = '\0';
+  else
+    {
+      size_t len = strlen (arg);
+      while (len > 1 && arg[len - 1] == '/')
+        arg[--len] = '\0';
+      pintos_path = strrchr (arg, '/');
+      pintos_path = pintos_path != NULL ? pintos_path + 1 : arg;
+    }
+  pintos_path = strdup (pintos_path);
+
+  name = strtok_r (pintos_path, "/", &save_ptr);
+  if (name == NULL)
+    {
+      add_host_dir (root, host_path);
+      return;
+    }
+  while ((next = strtok_r (NULL, "/", &save_ptr)) != NULL)
+    {
+      struct node *child = find_child (dir, name);
+      if (child == NULL)
+        {
+          child = new_node (name, true);
+          add_child (dir, child);
+        }
+      else if (!child->is_dir)
+        {
+          errno = 0;
+          fail ("%s: not a directory", name);
+        }
+      dir = child;
+      name = next;
+    }
+  add_host_tree (dir, host_path, name);
+}
+
+/* Builds IMAGE_FILE, SIZE_MB megabytes long, holding the files
+   named by ARGV[0] through ARGV[ARGC - 1]. */
+static void
+make_image (const char *image_file, double size_mb, int argc, char *argv[])
+{
+  struct node root;
+  block_sector_t free_map_data;
+  FILE *f;
+  int i;
+
+  image_sectors = (size_t) (size_mb * 1024 * 1024) / BLOCK_SECTOR_SIZE;
+  if (image_sectors < 8)
+    {
+      errno = 0;
+      fail ("image size %g MB is too small", size_mb);
+    }
+  image = xcalloc (image_sectors, BLOCK_SECTOR_SIZE);
+  free_map_bytes = 4 * DIV_ROUND_UP (image_sectors, 32);
+  free_map = xcalloc (1, free_map_bytes);
+
+  memset (&root, 0, sizeof root);
+  root.is_dir = true;
+  root.sector = ROOT_DIR_SECTOR;
+  for (i = 0; i < argc; i++)
+    add_arg (&root, argv[i]);
+
+  /* Sectors 0 to 2 are reserved, as in free_map_init().  The hot
+     sector list starts out empty, as after do_format(). */
+  allocate (3);
+  free_map_data = build_inode (FREE_MAP_SECTOR, free_map_bytes, false);
+  build_inode (HOT_LIST_SECTOR, 0, false);
+  build_node (&root, ROOT_DIR_SECTOR);
+  memcpy (sector_ptr (free_map_data), free_map, free_map_bytes);
+
+  f = fopen (image_file, "wb");
+  if (f == NULL)
+    fail ("%s: create", image_file);
+  if (fwrite (image, BLOCK_SECTOR_SIZE, image_sectors, f) != image_sectors
+      || fclose (f) != 0)
+    fail ("%s: write", image_file);
+
+  printf ("%s: %zu files, %zu directories, %lu of %zu sectors used\n",
+          image_file, built_files, built_dirs, (unsigned long) next_sector,
+          image_sectors);
+}
+
+/* Reading images. */
+
+static uint8_t *used;                   /* Sectors referenced so far. */
+static int errors;                      /* Inconsistencies found. */
+
+static void
+report (const char *msg, ...)
+     __attribute__ ((format (printf, 1, 2)));
+
+/* Reports an inconsistency in the image. */
+static void
+report (const char *msg, ...)
+{
+  va_list args;
+
+  printf ("error: ");
+  va_start (args, msg);
+  vprintf (msg, args);
+  va_end (args);
+  putchar ('\n');
+  errors++;
+}
+
+/* Records that SECTOR is in use by PATH.  Returns false, after
+   reporting the problem, if SECTOR is out of range or already
+   in use. */
+static bool
+claim (block_sector_t sector, const char *path)
+{
+  if (sector >= image_sectors)
+    {
+      report ("%s: sector %lu is past the end of the image",
+              path, (unsigned long) sector);
+      return false;
+    }
+  if (bit_test (used, sector))
+    {
+      report ("%s: sector %lu is used twice", path, (unsigned long) sector);
+      return false;
+    }
+  bit_mark (used, sector);
+  return true;
+}
+
+/* Reads the inode at SECTOR, claiming it and its index blocks
+   for PATH, and returns its data sectors in a new array, with
+   their number in *CNT.  Returns a null pointer if the inode is
+   unusable. */
+static block_sector_t *
+read_inode (block_sector_t sector, const char *path,
+            struct inode_disk **dp, size_t *cnt)
+{
+  struct inode_disk *d;
+  block_sector_t *blocks;
+  size_t i;
+
+  if (!claim (sector, path))
+    return NULL;
+  d = *dp = (struct inode_disk *) sector_ptr (sector);
+  if (d->magic != INODE_MAGIC)
+    {
+      report ("%s: bad magic number in inode %lu",
+              path, (unsigned long) sector);
+      return NULL;
+    }
+  if (d->length < 0 || d->sector_cnt > MAX_SECTORS
+      || (size_t) DIV_ROUND_UP (d->length, BLOCK_SECTOR_SIZE) > d->sector_cnt)
+    {
+      report ("%s: length %ld does not fit in %lu sectors",
+              path, (long) d->length, (unsigned long) d->sector_cnt);
+      return NULL;
+    }
+
+  *cnt = d->sector_cnt;
+  blocks = xcalloc (*cnt + 1, sizeof *blocks);
+  for (i = 0; i < *cnt; i++)
+    {
+      if (i < NUM_DIRECT_BLOCKS)
+        blocks[i] = d->direct_blocks[i];
+      else if (i < DOUBLY_INDIRECT_START)
+        {
+          if (i == NUM_DIRECT_BLOCKS && !claim (d->indirect_block, path))
+            goto error;
+          blocks[i] = index_table (d->indirect_block)[i - NUM_DIRECT_BLOCKS];
+        }
+      else
+        {
+          size_t j = i - DOUBLY_INDIRECT_START;
+          block_sector_t table;
+
+          if (j == 0 && !claim (d->doubly_indirect_block, path))
+            goto error;
+          table = index_table (d->doubly_indirect_block)
+                  [j / BLOCKS_PER_INDIRECT];
+          if (j % BLOCKS_PER_INDIRECT == 0 && !claim (table, path))
+            goto error;
+          blocks[i] = index_table (table)[j % BLOCKS_PER_INDIRECT];
+        }
+      if (!claim (blocks[i], path))
+        goto error;
+    }
+  return blocks;
+
+ error:
+  free (blocks);
+  return NULL;
+}
+
+/* Returns the number of contiguous runs in BLOCKS[0...CNT). */
+static size_t
+count_extents (const block_sector_t *blocks, size_t cnt)
+{
+  size_t extents = cnt > 0;
+  size_t i;
+
+  for (i = 1; i < cnt; i++)
+    if (blocks[i] != blocks[i - 1] + 1)
+      extents++;
+  return extents;
+}
+
+/* Totals for the fragmentation report. */
+static size_t file_cnt, fragmented_cnt, extent_cnt, data_sectors;
+static size_t worst_extents;
+static char *worst_path;
+
+/* Prints the extents of BLOCKS[0...CNT). */
+static void
+print_extents (const block_sector_t *blocks, size_t cnt)
+{
+  size_t i, start = 0;
+
+  for (i = 1; i <= cnt; i++)
+    if (i == cnt || blocks[i] != blocks[i - 1] + 1)
+      {
+        if (i - start == 1)
+          printf (" %lu", (unsigned long) blocks[start]);
+        else
+          printf (" %lu-%lu", (unsigned long) blocks[start],
+                  (unsigned long) blocks[i - 1]);
+        start = i;
+      }
+}
+
+/* Walks the inode at SECTOR, named PATH, and everything below
+   it.  If DUMP, lists each inode; otherwise lists only files
+   stored in more than one extent. */
+static void
+walk (block_sector_t sector, const char *path, bool dump)
+{
+  struct inode_disk *d;
+  block_sector_t *blocks;
+  size_t cnt, extents;
+
+  blocks = read_inode (sector, path, &d, &cnt);
+  if (blocks == NULL)
+    return;
+
+  extents = count_extents (blocks, cnt);
+  file_cnt++;
+  data_sectors += cnt;
+  extent_cnt += extents;
+  if (extents > 1)
+    fragmented_cnt++;
+  if (extents > worst_extents)
+    {
+      worst_extents = extents;
+      free (worst_path);
+      worst_path = strdup (path);
+    }
+  if (dump || extents > 1)
+    {
+      printf ("%-24s %4s inode %5lu %8ld bytes %5lu sectors %3zu extents:",
+              path, d->is_dir ? "dir" : "file", (unsigned long) sector,
+              (long) d->length, (unsigned long) cnt, extents);
+      print_extents (blocks, cnt);
+      putchar ('\n');
+    }
+
+  if (d->is_dir)
+    {
+      size_t entry_cnt = d->length / sizeof (struct dir_entry);
+      uint8_t *data = xcalloc (cnt + 1, BLOCK_SECTOR_SIZE);
+      size_t i;
+
+      for (i = 0; i < cnt; i++)
+        memcpy (data + i * BLOCK_SECTOR_SIZE, sector_ptr (blocks[i]),
+                BLOCK_SECTOR_SIZE);
+      for (i = 0; i < entry_cnt; i++)
+        {
+          struct dir_entry *e = (struct dir_entry *) data + i;
+          char *child_path;
+
+          if (!e->in_use || !strcmp (e->name, ".") || !strcmp (e->name, ".."))
+            continue;
+          if (memchr (e->name, '\0', sizeof e->name) == NULL)
+            {
+              report ("%s: entry %zu has an unterminated name", path, i);
+              continue;
+            }
+          if (asprintf (&child_path, "%s%s%s", path,
+                        sector == ROOT_DIR_SECTOR ? "" : "/", e->name) < 0)
+            fail ("out of memory");
+          walk (e->inode_sector, child_path, dump);
+          free (child_path);
+        }
+      free (data);
+    }
+  free (blocks);
+}
+
+/* Prints the free space in the image as runs of free sectors. */
+static void
+report_free_space (const uint8_t *map)
+{
+  size_t free_cnt = 0, runs = 0, largest = 0, run = 0;
+  size_t i;
+
+  for (i = 0; i < image_sectors; i++)
+    if (!bit_test (map, i))
+      {
+        free_cnt++;
+        if (run++ == 0)
+          runs++;
+        if (run > largest)
+          largest = run;
+      }
+    else
+      run = 0;
+  printf ("free space: %zu sectors in %zu runs, largest run %zu sectors\n",
+          free_cnt, runs, largest);
+}
+
+/* Checks IMAGE_FILE for consistency and prints either a listing
+   of every inode (if DUMP) or a fragmentation report.  Returns
+   the number of inconsistencies found. */
+static int
+read_image (const char *image_file, bool dump)
+{
+  struct inode_disk *d;
+  block_sector_t *blocks;
+  uint8_t *map;
+  size_t cnt, i;
+  FILE *f;
+  long size;
+
+  f = fopen (image_file, "rb");
+  if (f == NULL)
+    fail ("%s: open", image_file);
+  if (fseek (f, 0, SEEK_END) != 0 || (size = ftell (f)) < 0)
+    fail ("%s: seek", image_file);
+  rewind (f);
+  errno = 0;
+  if (size % BLOCK_SECTOR_SIZE != 0 || size < 2 * BLOCK_SECTOR_SIZE)
+    fail ("%s: not a file system image (%ld bytes)", image_file, size);
+  image_sectors = size / BLOCK_SECTOR_SIZE;
+  image = xcalloc (image_sectors, BLOCK_SECTOR_SIZE);
+  if (fread (image, BLOCK_SECTOR_SIZE, image_sectors, f) != image_sectors)
+    fail ("%s: read", image_file);
+  fclose (f);
+  used = xcalloc (1, DIV_ROUND_UP (image_sectors, 8));
+
+  /* Read the free map. */
+  blocks = read_inode (FREE_MAP_SECTOR, "(free map)", &d, &cnt);
+  if (blocks == NULL)
+    {
+      errno = 0;
+      fail ("%s: unreadable free map", image_file);
+    }
+  if ((size_t) d->length < DIV_ROUND_UP (image_sectors, 8))
+    report ("free map holds %ld bits but the image has %zu sectors",
+            (long) d->length * 8, image_sectors);
+  map = xcalloc (cnt + 1, BLOCK_SECTOR_SIZE);
+  for (i = 0; i < cnt; i++)
+    memcpy (map + i * BLOCK_SECTOR_SIZE, sector_ptr (blocks[i]),
+            BLOCK_SECTOR_SIZE);
+  if (dump)
+    {
+      printf ("%-24s %4s inode %5d %8ld bytes %5lu sectors %3zu extents:",
+              "(free map)", "file", FREE_MAP_SECTOR, (long) d->length,
+              (unsigned long) cnt, count_extents (blocks, cnt));
+      print_extents (blocks, cnt);
+      putchar ('\n');
+    }
+  free (blocks);
+
+  walk (HOT_LIST_SECTOR, "(hot list)", dump);
+  walk (ROOT_DIR_SECTOR, "/", dump);
+
+  /* Compare what the tree uses with what the free map says. */
+  for (i = 0; i < image_sectors; i++)
+    if (bit_test (used, i) && !bit_test (map, i))
+      report ("sector %zu is in use but free in the free map", i);
+    else if (!bit_test (used, i) && bit_test (map, i))
+      report ("sector %zu is allocated but not referenced", i);
+
+  if (!dump)
+    {
+      printf ("%zu inodes, %zu data sectors in %zu extents, "
+              "%.2f extents per inode\n",
+              file_cnt, data_sectors, extent_cnt,
+              file_cnt ? (double) extent_cnt / file_cnt : 0.0);
+      printf ("%zu inodes fragmented", fragmented_cnt);
+      if (worst_extents > 1)
+        printf (", worst is %s with %zu extents", worst_path, worst_extents);
+      putchar ('\n');
+      report_free_space (map);
+    }
+  if (errors)
+    printf ("%s: %d inconsistencies\n", image_file, errors);
+  return errors;
+}
+
+static void usage (void) __attribute__ ((noreturn));
+
+static void
+usage (void)
+{
+  printf ("pintos-mkfs, builds and inspects Pintos file system images\n"
+          "Usage: pintos-mkfs [-s MB] IMAGE [FILE[=PATH]]...\n"
+          "       pintos-mkfs -d IMAGE\n"
+          "       pintos-mkfs -f IMAGE\n"
+          "The first form creates IMAGE as a file system partition of\n"
+          "MB megabytes (default 2) holding each host FILE, or the\n"
+          "tree below each host directory FILE, at Pintos PATH (by\n"
+          "default, the host base name in the root directory).\n"
+          "Boot it with \"pintos --filesys=IMAGE\" and without -f.\n"
+          "Options:\n"
+          "  -s MB    Make the image MB megabytes large\n"
+          "  -d       Check IMAGE and list every inode and its extents\n"
+          "  -f       Check IMAGE and report on its fragmentation\n"
+          "  -h       Display this help message\n");
+  exit (EXIT_SUCCESS);
+}
+
+int
+main (int argc, char *argv[])
+{
+  double size_mb = 2.0;
+  char mode = 'c';
+  int opt;
+
+  if (sizeof (struct inode_disk) != BLOCK_SECTOR_SIZE
+      || sizeof (struct dir_entry) != 24)
+    {
+      errno = 0;
+      fail ("host structure layout does not match the kernel's");
+    }
+
+  while ((opt = getopt (argc, argv, "s:dfh")) != -1)
+    switch (opt)
+      {
+      case 's':
+        size_mb = strtod (optarg, NULL);
+        break;
+      case 'd':
+      case 'f':
+        mode = opt;
+        break;
+      case 'h':
+        usage ();
+      default:
+        fprintf (stderr, "Try `pintos-mkfs -h' for help.\n");
+        return EXIT_FAILURE;
+      }
+  argc -= optind;
+  argv += optind;
+  if (argc < 1 || (mode != 'c' && argc != 1))
+    {
+      fprintf (stderr, "Try `pintos-mkfs -h' for help.\n");
+      return EXIT_FAILURE;
+    }
+
+  if (mode == 'c')
+    {
+      make_image (argv[0], size_mb, argc - 1, argv + 1);
+      return EXIT_SUCCESS;
+    }
+  return read_image (argv[0], mode == 'd') ? EXIT_FAILURE : EXIT_SUCCESS;
+}
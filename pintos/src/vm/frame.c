@@ -19,6 +19,7 @@ struct hash frame_table;
 struct lock frame_table_lock;
 void *frame_evict (void);
 struct page *run_clock (void);
+static struct page *clock_scan (size_t *steps);
 void *hand;
 void *base;
 uint32_t user_pool_size;
@@ -61,9 +62,95 @@ frame_allocate (struct page *page)
 }
 
 
+/* Returns true if PAGE, which is in frame KPAGE, would have to be
+   written to swap to evict it. */
+static bool
+goes_to_swap (struct page *page, void *kpage)
+{
+    switch (page->type)
+    {
+        case SWAP:
+            return true;
+        case EXECUTABLE:
+        case ZERO:
+            return (pagedir_is_dirty (page->pd, page->vaddr)
+                    || pagedir_is_dirty (init_page_dir, kpage));
+        default:
+            return false;
+    }
+}
+
+/* Picks up to MAX more victims that have to go to swap, to write
+   out along with the page being evicted, and takes them out of
+   the frame table.  Stores them in PAGES and their frames in
+   KPAGES and returns how many there are.  Stops at the first
+   victim that would not go to swap or that is busy, leaving it
+   in place, and after the clock hand has gone around once.
+   frame_table_lock must be held. */
+static size_t
+gather_cluster (struct page **pages, void **kpages, size_t max)
+{
+    size_t steps = user_pool_size / PGSIZE;
+    size_t cnt = 0;
+
+    while (cnt < max)
+    {
+        struct page *page = clock_scan (&steps);
+
+        if (page == NULL
+            || (page->type == EXECUTABLE && !page->writable)
+            || !goes_to_swap (page, page->paddr)
+            || !lock_try_acquire (&page->busy))
+            break;
+        hash_delete (&frame_table, &page->frame_elem);
+        pages[cnt] = page;
+        kpages[cnt] = page->paddr;
+        page->paddr = NULL;
+        cnt++;
+    }
+    return cnt;
+}
+
+/* Writes the CNT pages in PAGES, in frames KPAGES, to swap, in
+   consecutive slots if there is a long enough run of free ones,
+   and marks them swapped out. */
+static void
+swap_out_cluster (struct page **pages, void **kpages, size_t cnt)
+{
+    uint32_t first_slot;
+    size_t i;
+
+    if (cnt == 0)
+        return;
+    first_slot = swap_allocate_slots (cnt);
+    if (first_slot != BITMAP_ERROR)
+        swap_write_pages (first_slot, kpages, cnt);
+    for (i = 0; i < cnt; i++)
+    {
+        pages[i]->type = SWAP;
+        if (first_slot != BITMAP_ERROR)
+            pages[i]->swap_slot = first_slot + i;
+        else
+        {
+            pages[i]->swap_slot = swap_allocate_slot ();
+            swap_write_page (pages[i]->swap_slot, kpages[i]);
+        }
+        swap_set_owner (pages[i]->swap_slot, pages[i]);
+    }
+}
+
+/* Evicts a page to free its frame, and returns the frame.  If the
+   page has to go to swap, up to SWAP_CLUSTER_MAX - 1 other victims
+   that have to as well are written out with it, to consecutive
+   swap slots in one batch, and their frames are freed. */
 void *
 frame_evict (void)
 {
+    struct page *cluster[SWAP_CLUSTER_MAX];
+    void *kpages[SWAP_CLUSTER_MAX];
+    size_t cluster_cnt = 0;
+    size_t i;
+
     lock_acquire (&frame_table_lock);
     struct page *page_to_evict;
 
@@ -76,8 +163,15 @@ frame_evict (void)
     lock_acquire (&page_to_evict->busy);
     hash_delete (&frame_table, &page_to_evict->frame_elem);
     page_to_evict->paddr = NULL;
+    /* Only a victim that goes to swap itself is worth gathering
+       others for: a clean one is just dropped. */
+    if (goes_to_swap (page_to_evict, kpage))
+        cluster_cnt = gather_cluster (cluster + 1, kpages + 1,
+                                      SWAP_CLUSTER_MAX - 1);
     lock_release (&frame_table_lock);
     pagedir_clear_page (page_to_evict->pd, page_to_evict->vaddr);
+    for (i = 1; i <= cluster_cnt; i++)
+        pagedir_clear_page (cluster[i]->pd, cluster[i]->vaddr);
 
     switch (page_to_evict->type)
     {
@@ -87,18 +181,8 @@ frame_evict (void)
                 sharing_invalidate (page_to_evict);
             }
         case ZERO:
-            if (pagedir_is_dirty (page_to_evict->pd, page_to_evict->vaddr)
-                || pagedir_is_dirty (init_page_dir, kpage))
-            {
-                //move to swap
-                page_to_evict->type = SWAP;
-                page_to_evict->swap_slot = swap_allocate_slot ();
-                swap_write_page ( page_to_evict->swap_slot, kpage);
-            }
-            break;
         case SWAP:
-            page_to_evict->swap_slot = swap_allocate_slot ();
-            swap_write_page ( page_to_evict->swap_slot, kpage);
+            // the clustered write below moves it to swap
             break;
         case MMAPPED:
             if (pagedir_is_dirty (page_to_evict->pd, page_to_evict->vaddr)
@@ -112,9 +196,23 @@ frame_evict (void)
             break;            
     }
 
+    /* Write the victim, if it has to go to swap, and the other
+       victims gathered with it, to swap together. */
+    if (goes_to_swap (page_to_evict, kpage))
+    {
+        cluster[0] = page_to_evict;
+        kpages[0] = kpage;
+        swap_out_cluster (cluster, kpages, cluster_cnt + 1);
+    }
+    else
+        swap_out_cluster (cluster + 1, kpages + 1, cluster_cnt);
 
     lock_release (&page_to_evict->busy);
-
+    for (i = 1; i <= cluster_cnt; i++)
+    {
+        lock_release (&cluster[i]->busy);
+        palloc_free_page (kpages[i]);
+    }
 
     return kpage;
 
@@ -169,17 +267,50 @@ frame_init_base (void *user_base, void *user_end)
   hand = user_base;
 }
 
+/* Returns the number of user frames in use. */
+size_t
+frame_used_cnt (void)
+{
+  size_t cnt;
+  lock_acquire (&frame_table_lock);
+  cnt = hash_size (&frame_table);
+  lock_release (&frame_table_lock);
+  return cnt;
+}
+
+/* Returns the number of frames in the user pool. */
+size_t
+frame_total_cnt (void)
+{
+  return user_pool_size / PGSIZE;
+}
+
 /* Returns pointer to the physical frame that should be written to next.
    This algorithm approximates a LRU heuristic.  Only checks user pages,
    as kernal pages should never be evicted. This frame pointer is then
    passed to the eviction function. */
 struct page *
 run_clock (void) 
+{
+  return clock_scan (NULL);
+}
+
+/* Runs the clock as run_clock() does, but if STEPS is non-null,
+   for at most *STEPS advances of the hand, which are deducted
+   from *STEPS.  Returns a null pointer if they run out. */
+static struct page *
+clock_scan (size_t *steps)
 {
   struct page p;  // Dummy page for hash_find comparison.
   struct page *page_to_evict; // Pointer to the actual page.
   struct hash_elem *e;
   while (true) {
+    if (steps != NULL)
+      {
+        if (*steps == 0)
+          return NULL;
+        (*steps)--;
+      }
     //advance hand:
     hand = (uint32_t) (hand + PGSIZE - base) % user_pool_size + base;
     p.paddr = hand;
@@ -18,6 +18,8 @@ void frame_unpin (void *vaddr);
 void frame_dump_frame ( struct hash_elem *elem, void *aux UNUSED);
 void frame_dump_table (void);
 void frame_init_base (void *user_base, void *user_end);
+size_t frame_used_cnt (void);
+size_t frame_total_cnt (void);
 
 
 
@@ -220,7 +220,7 @@ page_in (struct page *supp_page)
       memset (supp_page->paddr + supp_page->valid_bytes, 0, PGSIZE - supp_page->valid_bytes);
       break;
     case SWAP:
-      swap_read_page (supp_page->swap_slot, supp_page->paddr);
+      swap_read_in (supp_page, supp_page->paddr);
       swap_free (supp_page->swap_slot);
       supp_page->swap_slot = -1;
       break;
@@ -1,20 +1,88 @@
 #include "swap.h"
 #include "devices/block.h"
 #include <kernel/bitmap.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#include "page.h"
 
+/* Sectors in one page-sized swap slot, moved with one command. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Most slots swap_read_in() reads at once: the one faulted in and
+	the slots after it that hold the same process's following
+	virtual pages. */
+#define SWAP_READ_AROUND 8
+
+/* Pages in the swap cache, which holds slots read around ones that
+	were faulted in, until their own pages fault in. */
+#define SWAP_CACHE_SIZE 16
+
+struct swap_cache_entry
+{
+	uint32_t swap_slot;
+	void *kpage; // copy of the slot, or NULL if the entry is empty
+};
+
+/* Owner table and swap cache, protected by swap_lock. */
+static struct page **slot_owners; // page swapped out to each slot
+static struct swap_cache_entry swap_cache[SWAP_CACHE_SIZE];
+static size_t swap_cache_next; // next entry to replace
+static unsigned long long swap_cache_hits;
+
+static void swap_cache_drop (uint32_t swap_slot);
 
 void swap_init (void)
 {
 	struct block *swap_block = block_get_role (BLOCK_SWAP);
 	swap_bitmap = bitmap_create (block_size (swap_block) * BLOCK_SECTOR_SIZE / PGSIZE);
+	slot_owners = calloc (bitmap_size (swap_bitmap), sizeof *slot_owners);
+	if (slot_owners == NULL)
+		PANIC ("swap slot owner table allocation failed");
 	lock_init (&swap_lock);
 }
 
+/* Returns the number of swap slots in use. */
+size_t swap_used_cnt (void)
+{
+	size_t cnt;
+	lock_acquire (&swap_lock);
+	cnt = bitmap_count (swap_bitmap, 0, bitmap_size (swap_bitmap), true);
+	lock_release (&swap_lock);
+	return cnt;
+}
+
+/* Returns the number of swap slots on the swap device. */
+size_t swap_total_cnt (void)
+{
+	return bitmap_size (swap_bitmap);
+}
+
+/* Returns the number of page faults served from the swap cache. */
+unsigned long long swap_cache_hit_cnt (void)
+{
+	return swap_cache_hits;
+}
+
 void swap_free (uint32_t swap_slot)
 {
+	lock_acquire (&swap_lock);
+	slot_owners[swap_slot] = NULL;
+	swap_cache_drop (swap_slot);
 	bitmap_reset (swap_bitmap, swap_slot);
+	lock_release (&swap_lock);
+}
+
+/* Records that PAGE is swapped out to SWAP_SLOT, for swap_read_in()
+	to find the slots of its neighbours. */
+void swap_set_owner (uint32_t swap_slot, struct page *page)
+{
+	ASSERT (bitmap_all (swap_bitmap, swap_slot, 1));
+	lock_acquire (&swap_lock);
+	slot_owners[swap_slot] = page;
+	lock_release (&swap_lock);
 }
 
 uint32_t swap_allocate_slot (void)
@@ -26,29 +94,182 @@ uint32_t swap_allocate_slot (void)
 	return swap_slot;
 }
 
+/* Allocates CNT consecutive swap slots and returns the first, or
+	BITMAP_ERROR if there is no such run of free slots. */
+uint32_t swap_allocate_slots (size_t cnt)
+{
+	lock_acquire (&swap_lock);
+	uint32_t swap_slot = bitmap_scan_and_flip (swap_bitmap, 0, cnt, false);
+	lock_release (&swap_lock);
+	return swap_slot;
+}
+
 void swap_read_page (uint32_t swap_slot, void *upage)
 {
 	ASSERT (bitmap_all (swap_bitmap, swap_slot, 1));
 	struct block *swap_block = block_get_role (BLOCK_SWAP);
-	int sector_count;
-	block_sector_t block_sector;
-	for (sector_count = 0; sector_count < PGSIZE / BLOCK_SECTOR_SIZE; sector_count ++)
-	{
-		block_sector = swap_slot * PGSIZE / BLOCK_SECTOR_SIZE + sector_count;
-		block_read (swap_block, block_sector, upage + sector_count * BLOCK_SECTOR_SIZE);
-	}
+	enum block_io_class old_class = block_set_io_class (BLOCK_IO_SWAP);
+	block_read_multiple (swap_block, swap_slot * SECTORS_PER_SLOT,
+			     SECTORS_PER_SLOT, upage);
+	block_set_io_class (old_class);
 }
 
 void swap_write_page (uint32_t swap_slot, void *upage)
 {
 	ASSERT (bitmap_all (swap_bitmap, swap_slot, 1));
 	struct block *swap_block = block_get_role (BLOCK_SWAP);
-	int sector_count;
-	block_sector_t block_sector;
-	for (sector_count = 0; sector_count < PGSIZE / BLOCK_SECTOR_SIZE; sector_count ++)
+	enum block_io_class old_class = block_set_io_class (BLOCK_IO_SWAP);
+	block_write_multiple (swap_block, swap_slot * SECTORS_PER_SLOT,
+			      SECTORS_PER_SLOT, upage);
+	block_set_io_class (old_class);
+}
+
+/* Wakes up transfer_pages() for finished request R. */
+static void
+transfer_done (struct block_request *r)
+{
+	sema_up (r->aux);
+}
+
+/* Reads or writes, according to WRITE, the CNT consecutive swap
+	slots starting at FIRST_SLOT from or to the CNT pages in PAGES,
+	which need not be contiguous in memory.  The pages are queued
+	as one batch, so the block layer merges them into as few
+	device commands as it can. */
+static void
+transfer_pages (uint32_t first_slot, void **pages, size_t cnt, bool write)
+{
+	struct block_request requests[SWAP_CLUSTER_MAX];
+	struct semaphore done;
+	size_t i;
+
+	ASSERT (cnt <= SWAP_CLUSTER_MAX);
+	ASSERT (bitmap_all (swap_bitmap, first_slot, cnt));
+	struct block *swap_block = block_get_role (BLOCK_SWAP);
+	enum block_io_class old_class = block_set_io_class (BLOCK_IO_SWAP);
+	sema_init (&done, 0);
+	for (i = 0; i < cnt; i++)
 	{
-		block_sector = swap_slot * PGSIZE / BLOCK_SECTOR_SIZE + sector_count;
-		block_write (swap_block, block_sector, upage + sector_count * BLOCK_SECTOR_SIZE);
+		requests[i].sector = (first_slot + i) * SECTORS_PER_SLOT;
+		requests[i].cnt = SECTORS_PER_SLOT;
+		requests[i].buffer = pages[i];
+		requests[i].write = write;
+		requests[i].done = transfer_done;
+		requests[i].aux = &done;
 	}
+	block_submit_batch (swap_block, requests, cnt);
+	for (i = 0; i < cnt; i++)
+		sema_down (&done);
+	block_set_io_class (old_class);
+}
+
+/* Writes the CNT pages in PAGES to the CNT consecutive swap slots
+	starting at FIRST_SLOT, in as few device commands as the block
+	layer can. */
+void swap_write_pages (uint32_t first_slot, void **pages, size_t cnt)
+{
+	transfer_pages (first_slot, pages, cnt, true);
+}
+
+/* Returns the swap cache entry for SWAP_SLOT, or NULL if it is not
+	cached.  swap_lock must be held. */
+static struct swap_cache_entry *
+swap_cache_find (uint32_t swap_slot)
+{
+	size_t i;
+
+	for (i = 0; i < SWAP_CACHE_SIZE; i++)
+		if (swap_cache[i].kpage != NULL
+		    && swap_cache[i].swap_slot == swap_slot)
+			return &swap_cache[i];
+	return NULL;
+}
+
+/* Empties swap cache entry E. */
+static void
+swap_cache_clear (struct swap_cache_entry *e)
+{
+	palloc_free_page (e->kpage);
+	e->kpage = NULL;
+}
+
+/* Forgets the cached copy of SWAP_SLOT, if any.  swap_lock must be
+	held. */
+static void
+swap_cache_drop (uint32_t swap_slot)
+{
+	struct swap_cache_entry *e = swap_cache_find (swap_slot);
+
+	if (e != NULL)
+		swap_cache_clear (e);
+}
+
+/* Caches KPAGE, a kernel page read from SWAP_SLOT, replacing the
+	oldest entry if the cache is full.  swap_lock must be held. */
+static void
+swap_cache_insert (uint32_t swap_slot, void *kpage)
+{
+	struct swap_cache_entry *e = &swap_cache[swap_cache_next];
+
+	swap_cache_next = (swap_cache_next + 1) % SWAP_CACHE_SIZE;
+	if (e->kpage != NULL)
+		swap_cache_clear (e);
+	e->swap_slot = swap_slot;
+	e->kpage = kpage;
 }
 
+/* Reads PAGE, which is swapped out, into frame KPAGE, from the swap
+	cache if it is there.  Otherwise, in the same device command,
+	also reads into the swap cache the slots after PAGE's that hold
+	the same process's following virtual pages, so that faulting
+	them in later needs no I/O.  Slots whose pages are busy end the
+	run.  PAGE->busy must be held. */
+void swap_read_in (struct page *page, void *kpage)
+{
+	struct page *neighbours[SWAP_READ_AROUND];
+	void *kpages[SWAP_READ_AROUND];
+	uint32_t swap_slot = page->swap_slot;
+	struct swap_cache_entry *e;
+	size_t cnt, i;
+
+	lock_acquire (&swap_lock);
+	e = swap_cache_find (swap_slot);
+	if (e != NULL)
+	{
+		memcpy (kpage, e->kpage, PGSIZE);
+		swap_cache_clear (e);
+		swap_cache_hits++;
+		lock_release (&swap_lock);
+		return;
+	}
+	for (cnt = 1; cnt < SWAP_READ_AROUND
+		      && swap_slot + cnt < bitmap_size (swap_bitmap); cnt++)
+	{
+		// holding the neighbour's busy lock keeps it swapped out
+		// and its slot its own until the read is done
+		struct page *q = slot_owners[swap_slot + cnt];
+		if (q == NULL || q->pd != page->pd
+		    || q->vaddr != (uint8_t *) page->vaddr + cnt * PGSIZE
+		    || swap_cache_find (swap_slot + cnt) != NULL
+		    || !lock_try_acquire (&q->busy))
+			break;
+		kpages[cnt] = palloc_get_page (0);
+		if (kpages[cnt] == NULL)
+		{
+			lock_release (&q->busy);
+			break;
+		}
+		neighbours[cnt] = q;
+	}
+	lock_release (&swap_lock);
+
+	kpages[0] = kpage;
+	transfer_pages (swap_slot, kpages, cnt, false);
+
+	lock_acquire (&swap_lock);
+	for (i = 1; i < cnt; i++)
+		swap_cache_insert (swap_slot + i, kpages[i]);
+	lock_release (&swap_lock);
+	for (i = 1; i < cnt; i++)
+		lock_release (&neighbours[i]->busy);
+}
@@ -6,15 +6,26 @@
 #include <kernel/bitmap.h>
 #include "threads/synch.h"
 
+struct page;
+
+/* Most pages swap_write_pages() writes at once. */
+#define SWAP_CLUSTER_MAX 8
 
 struct bitmap *swap_bitmap;
 struct lock swap_lock;
 
 void swap_init (void);
+size_t swap_used_cnt (void);
+size_t swap_total_cnt (void);
 void swap_free (uint32_t swap_slot);
+void swap_set_owner (uint32_t swap_slot, struct page *page);
+unsigned long long swap_cache_hit_cnt (void);
 uint32_t swap_allocate_slot (void);
+uint32_t swap_allocate_slots (size_t cnt);
 void swap_read_page (uint32_t swap_slot, void *buf);
 void swap_write_page (uint32_t swap_slot, void *buf);
+void swap_write_pages (uint32_t first_slot, void **pages, size_t cnt);
+void swap_read_in (struct page *page, void *kpage);
 
 
 #endif